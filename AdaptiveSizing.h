@@ -0,0 +1,142 @@
+/*
+AdaptiveSizing.h
+Decides how many command workers the ThreadPool should keep active.
+
+Every interval the pool samples the command path (queue depth, p99 time
+in queue, how busy the active workers were, and how much of that time was
+spent waiting for locks) and asks the AdaptiveSizer for a worker count.
+The sizer looks for the smallest count that holds the latency target:
+
+- over target and mostly doing work: grow by one worker
+- over target but mostly waiting for locks: shrink by one, since another
+  thread would only add contention
+- within target and under-used, or lock-bound: shrink by one after
+  `shrink_after` consecutive intervals agree
+
+Growing is immediate, shrinking needs a streak, so a short lull does not
+park a worker the next burst needs.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sstream>
+#include <algorithm>
+
+struct AdaptiveSizingConfig {
+    size_t min_workers = 1;
+    size_t max_workers = 0;                          // 0 = every shard
+    // p99 enqueue -> dequeue. The p99 is known only to a power of two, so the
+    // target is missed once the p99 bucket starts above it: a p99 of up to
+    // twice the target can still count as met.
+    std::chrono::microseconds latency_target{2000};
+    std::chrono::milliseconds interval{500};
+    double shrink_utilization = 0.30;    // busy share of the active workers' time
+    double max_lock_wait_share = 0.25;   // lock-wait share of the busy time
+    size_t depth_per_worker = 64;        // queued commands per active worker before growing
+    size_t shrink_after = 3;             // consecutive intervals before parking a worker
+
+    // Optional: cumulative nanoseconds the workers spent waiting for locks
+    // outside the queues (e.g. GameState::lock_wait_ns)
+    std::function<uint64_t()> lock_wait_probe;
+};
+
+// What the pool measured over one interval
+struct LoadSample {
+    size_t active_workers = 0;
+    size_t queue_depth = 0;          // commands queued or being applied, all shards
+    uint64_t commands = 0;           // commands completed in the interval
+    // Lower bound of the log2 bucket holding the p99 time in queue, so the
+    // true p99 is in [queue_wait_p99_ns, 2 * queue_wait_p99_ns); 0 if the
+    // queue type records no wait times
+    uint64_t queue_wait_p99_ns = 0;
+    double utilization = 0.0;        // busy time / (interval * active workers)
+    double lock_wait_share = 0.0;    // lock-wait time / busy time
+};
+
+struct ResizeDecision {
+    size_t workers = 0;
+    const char* reason = "";
+};
+
+// A decision that changed the worker count, as kept in the pool's resize log
+struct ResizeEvent {
+    std::chrono::steady_clock::time_point at;
+    size_t from = 0;
+    size_t to = 0;
+    const char* reason = "";
+    LoadSample sample;
+};
+
+class AdaptiveSizer {
+private:
+    AdaptiveSizingConfig m_config;
+    size_t m_shrink_streak = 0;
+
+public:
+    /**
+     * @brief Creates a sizer; max_workers of 0 becomes `shard_count`.
+     */
+    AdaptiveSizer(AdaptiveSizingConfig config, size_t shard_count) : m_config(std::move(config)) {
+        if (m_config.max_workers == 0 || m_config.max_workers > shard_count) m_config.max_workers = shard_count;
+        m_config.min_workers = std::clamp<size_t>(m_config.min_workers, 1, m_config.max_workers);
+    }
+
+    const AdaptiveSizingConfig& config() const { return m_config; }
+
+    /**
+     * @brief Worker count for the next interval, given the last one's sample.
+     * Returns the current count (with an empty reason) when nothing changes.
+     */
+    ResizeDecision evaluate(const LoadSample& sample) {
+        const size_t active = sample.active_workers;
+        const uint64_t target_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(m_config.latency_target).count());
+        const bool over_target = sample.queue_wait_p99_ns > target_ns
+                              || sample.queue_depth > active * m_config.depth_per_worker;
+        const bool lock_bound = sample.lock_wait_share > m_config.max_lock_wait_share;
+
+        if (active < m_config.min_workers) return {m_config.min_workers, "below minimum"};
+        if (active > m_config.max_workers) return {m_config.max_workers, "above maximum"};
+
+        if (over_target) {
+            m_shrink_streak = 0;
+            if (lock_bound) {
+                // More threads would queue on the same lock; fewer hold it for longer batches
+                return active > m_config.min_workers ? ResizeDecision{active - 1, "over target, lock-bound"}
+                                                     : ResizeDecision{active, ""};
+            }
+            return active < m_config.max_workers ? ResizeDecision{active + 1, "over latency target"}
+                                                 : ResizeDecision{active, ""};
+        }
+
+        const char* reason = nullptr;
+        if (lock_bound) reason = "lock contention";
+        else if (sample.utilization < m_config.shrink_utilization) reason = "underutilized";
+        if (!reason || active <= m_config.min_workers) {
+            m_shrink_streak = 0;
+            return {active, ""};
+        }
+        if (++m_shrink_streak < m_config.shrink_after) return {active, ""};
+        m_shrink_streak = 0;
+        return {active - 1, reason};
+    }
+};
+
+/**
+ * @brief One log line for a resize, e.g.
+ * "4 -> 3 workers (underutilized): util 12%, lock wait 3%, p99 >=64us, depth 0, 1200 cmds"
+ */
+inline std::string describe_resize(const ResizeEvent& event) {
+    std::ostringstream out;
+    out << event.from << " -> " << event.to << " workers (" << event.reason << "): util "
+        << static_cast<int>(event.sample.utilization * 100.0) << "%, lock wait "
+        << static_cast<int>(event.sample.lock_wait_share * 100.0) << "%, p99 >="
+        << event.sample.queue_wait_p99_ns / 1000 << "us, depth " << event.sample.queue_depth
+        << ", " << event.sample.commands << " cmds";
+    return out.str();
+}
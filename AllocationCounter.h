@@ -0,0 +1,23 @@
+/*
+AllocationCounter.h
+Counts global heap allocations (every operator new), process-wide and per
+thread, so a hot path can be checked for allocation-free steady state:
+
+    uint64_t before = global_allocations();
+    run_frame();
+    uint64_t allocated = global_allocations() - before;
+
+The counting operator new/delete replacements live in AllocationCounter.cpp;
+link it into the program to enable them. Counting is one relaxed atomic
+increment per allocation.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// operator new calls since startup, on all threads
+uint64_t global_allocations();
+
+// operator new calls made by the calling thread
+uint64_t thread_allocations();
@@ -0,0 +1,206 @@
+/*
+CoalescingQueue.h
+A SafeQueue variant that merges pending items with the same key.
+
+A pushed item whose key matches one that is still waiting in the queue
+replaces it in place (keeping the older item's position), instead of being
+appended. For PlayerCommand, keyed by player and action, several FLAPs that
+arrive within one physics tick collapse into one, so queue depth and worker
+work scale with the number of active players rather than with input spam.
+*/
+
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include <span>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+
+template <typename T, typename KeyFn>
+class CoalescingQueue {
+private:
+    using Key = std::invoke_result_t<KeyFn, const T&>;
+
+    std::deque<T> m_items;
+    // Key -> absolute sequence number of its pending item (index = seq - m_head_seq)
+    std::unordered_map<Key, uint64_t> m_pending;
+    uint64_t m_head_seq = 0;
+
+    KeyFn m_key_fn;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<bool> m_stop{false};
+    std::atomic<uint64_t> m_coalesced{0};
+
+    // Told about every pending item a merge replaces (see set_discard_handler)
+    std::function<void(const T&)> m_on_discard;
+
+    // Removes the front item into `item`; caller must hold m_mutex
+    void take_front(T& item) {
+        m_pending.erase(m_key_fn(m_items.front()));
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        ++m_head_seq;
+    }
+
+public:
+    CoalescingQueue() = default;
+    explicit CoalescingQueue(KeyFn key_fn) : m_key_fn(std::move(key_fn)) {}
+
+    /**
+     * @brief Sets a callback for pending items that a merge replaces, so
+     * callers tracking every accepted item can account for them. It runs
+     * under the queue lock, so keep it short and do not touch the queue from
+     * it; set it before the queue is shared.
+     */
+    void set_discard_handler(std::function<void(const T&)> handler) {
+        m_on_discard = std::move(handler);
+    }
+
+    /**
+     * @brief Push an item, replacing a pending item with the same key if there is one
+     * @return True if the item was enqueued or merged, false if the queue is stopped
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_stop) return false;
+
+        auto [it, inserted] = m_pending.try_emplace(m_key_fn(item), m_head_seq + m_items.size());
+        if (!inserted) {
+            // Already pending: a consumer is (or will be) woken for it, so no notify
+            T& pending = m_items[it->second - m_head_seq];
+            if (m_on_discard) m_on_discard(pending);
+            pending = std::move(item);
+            m_coalesced.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        m_items.push_back(std::move(item));
+        m_condition.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop an item from the queue
+     * @param item Reference to store the popped value
+     * @return True if an item was popped, false if the queue is stopped and empty
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]
+            { return m_stop || !m_items.empty(); }
+        );
+        if (m_items.empty()) return false;
+
+        take_front(item);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item without waiting
+     * @return True if an item was popped, false if the queue was empty
+     */
+    bool try_pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_items.empty()) return false;
+        take_front(item);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most until the deadline
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait_until(lock, deadline, [this]
+            { return m_stop || !m_items.empty(); }
+        );
+        if (m_items.empty()) return false;
+
+        take_front(item);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most for the given duration
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Pop up to max items into a caller-provided buffer under a single lock
+     * Blocks until at least one item is available or the queue is stopped.
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]
+            { return m_stop || !m_items.empty(); }
+        );
+
+        size_t count = 0;
+        while (count < max && !m_items.empty()) {
+            take_front(out[count++]);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait_until(lock, deadline, [this]
+            { return m_stop || !m_items.empty(); }
+        );
+
+        size_t count = 0;
+        while (count < max && !m_items.empty()) {
+            take_front(out[count++]);
+        }
+        return count;
+    }
+
+    /**
+     * signals queue to stop, wakes up all waiting threads
+    */
+    void stop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_condition.notify_all();
+    }
+
+    /**
+     * @brief True once stop() has been called (items may still be queued)
+     */
+    bool stopped() const {
+        return m_stop.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of pushes that were merged into an already pending item
+     */
+    uint64_t coalesced() const {
+        return m_coalesced.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,282 @@
+/*
+CpuAffinity.cpp
+Topology discovery from /sys and thread pinning (Linux), with portable
+fallbacks elsewhere.
+*/
+
+#include "CpuAffinity.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+const char* const SYS_CPU_DIR = "/sys/devices/system/cpu";
+
+// Reads a whole sysfs file, trimmed; empty if it does not exist
+std::string read_sys_file(const std::string& path) {
+    std::ifstream file(path);
+    std::string text;
+    std::getline(file, text);
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) text.pop_back();
+    return text;
+}
+
+int read_sys_int(const std::string& path, int fallback) {
+    std::string text = read_sys_file(path);
+    if (text.empty()) return fallback;
+    return std::atoi(text.c_str());
+}
+
+bool pin(pthread_t thread, int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+#endif
+
+// Largest CPU number a kernel can be configured with (NR_CPUS); keeps a typo
+// like "0-99999999" from expanding into a huge list before it is rejected
+constexpr int MAX_CPU_NUMBER = 8191;
+
+// Parses a whole string as a CPU number; false on anything else
+bool parse_cpu(const std::string& text, int& cpu) {
+    if (text.empty()) return false;
+    const char* last = text.data() + text.size();
+    auto [end, error] = std::from_chars(text.data(), last, cpu);
+    return error == std::errc() && end == last && cpu >= 0 && cpu <= MAX_CPU_NUMBER;
+}
+
+// The CPUs of `list` if it is a well-formed list of online CPUs, else empty
+std::vector<int> online_cpus_in(const std::string& list, const CpuTopology& topology) {
+    if (!is_cpu_list(list)) return {};
+    std::vector<int> cpus = parse_cpu_list(list);
+    for (int cpu : cpus) {
+        if (!topology.find(cpu)) return {};
+    }
+    return cpus;
+}
+
+} // namespace
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool is_cpu_list(const std::string& list) {
+    if (list.empty() || list.back() == ',') return false;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        size_t dash = range.find('-');
+        int first = 0;
+        int last = 0;
+        if (!parse_cpu(range.substr(0, dash), first)) return false;
+        if (dash != std::string::npos && (!parse_cpu(range.substr(dash + 1), last) || last < first)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CpuTopology CpuTopology::detect() {
+    CpuTopology topology;
+#ifdef __linux__
+    for (int cpu : parse_cpu_list(read_sys_file(std::string(SYS_CPU_DIR) + "/online"))) {
+        std::string dir = std::string(SYS_CPU_DIR) + "/cpu" + std::to_string(cpu) + "/topology/";
+        LogicalCpu entry;
+        entry.cpu = cpu;
+        entry.core_id = read_sys_int(dir + "core_id", cpu);
+        entry.package_id = read_sys_int(dir + "physical_package_id", 0);
+        topology.m_cpus.push_back(entry);
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (const auto& entry : topology.m_cpus) {
+            if (CPU_ISSET(entry.cpu, &allowed)) topology.m_allowed.push_back(entry.cpu);
+        }
+    }
+#endif
+    if (topology.m_cpus.empty()) {
+        // No /sys (or not Linux): assume every logical CPU is its own core
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            topology.m_cpus.push_back(LogicalCpu{static_cast<int>(cpu), static_cast<int>(cpu), 0});
+        }
+    }
+    if (topology.m_allowed.empty()) {
+        for (const auto& entry : topology.m_cpus) topology.m_allowed.push_back(entry.cpu);
+    }
+    return topology;
+}
+
+const LogicalCpu* CpuTopology::find(int cpu) const {
+    for (const auto& entry : m_cpus) {
+        if (entry.cpu == cpu) return &entry;
+    }
+    return nullptr;
+}
+
+std::vector<int> CpuTopology::siblings_of(int cpu) const {
+    std::vector<int> siblings;
+    const LogicalCpu* self = find(cpu);
+    if (!self) return siblings;
+    for (const auto& entry : m_cpus) {
+        if (entry.package_id == self->package_id && entry.core_id == self->core_id) {
+            siblings.push_back(entry.cpu);
+        }
+    }
+    return siblings;
+}
+
+std::vector<int> CpuTopology::one_per_physical_core() const {
+    std::vector<int> result;
+    std::set<std::pair<int, int>> seen; // (package, core)
+    for (int cpu : m_allowed) {
+        const LogicalCpu* entry = find(cpu);
+        if (entry && seen.insert({entry->package_id, entry->core_id}).second) {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
+
+size_t CpuTopology::physical_core_count() const {
+    std::set<std::pair<int, int>> cores;
+    for (const auto& entry : m_cpus) cores.insert({entry.package_id, entry.core_id});
+    return cores.size();
+}
+
+PlacementPlan plan_placement(const PlacementConfig& config, const CpuTopology& topology, size_t num_workers) {
+    PlacementPlan plan;
+    plan.render_cpu = config.render_cpu;
+    plan.worker_cpus.assign(num_workers, -1);
+
+    std::vector<int> candidates;
+    switch (config.mode) {
+    case PlacementMode::None:
+        return plan;
+    case PlacementMode::CoreList:
+        candidates = config.worker_cpus;
+        break;
+    case PlacementMode::OnePerPhysicalCore:
+        candidates = topology.one_per_physical_core();
+        break;
+    }
+
+    if (config.render_cpu >= 0 && config.avoid_render_siblings) {
+        std::vector<int> reserved = topology.siblings_of(config.render_cpu);
+        reserved.push_back(config.render_cpu);
+        std::vector<int> kept;
+        for (int cpu : candidates) {
+            if (std::find(reserved.begin(), reserved.end(), cpu) == reserved.end()) kept.push_back(cpu);
+        }
+        // Only honour the reservation if something is left for the workers
+        if (!kept.empty()) candidates = std::move(kept);
+    }
+    if (candidates.empty()) return plan;
+
+    for (size_t i = 0; i < num_workers; ++i) {
+        plan.worker_cpus[i] = candidates[i % candidates.size()];
+    }
+    return plan;
+}
+
+bool pin_thread(std::thread& thread, int cpu) {
+#ifdef __linux__
+    return pin(thread.native_handle(), cpu);
+#else
+    (void)thread;
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool pin_current_thread(int cpu) {
+#ifdef __linux__
+    return pin(pthread_self(), cpu);
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+std::string describe_placement(const PlacementPlan& plan, const CpuTopology& topology) {
+    std::ostringstream out;
+    auto describe_cpu = [&topology, &out](int cpu) {
+        if (cpu < 0) {
+            out << "unpinned";
+            return;
+        }
+        out << "cpu " << cpu;
+        if (const LogicalCpu* entry = topology.find(cpu)) {
+            out << " (package " << entry->package_id << ", core " << entry->core_id
+                << ", " << topology.siblings_of(cpu).size() << " SMT thread(s))";
+        }
+    };
+
+    out << "  " << topology.cpus().size() << " logical CPUs, " << topology.physical_core_count()
+        << " physical cores, " << topology.allowed_cpus().size() << " allowed\n";
+    out << "  render thread -> ";
+    describe_cpu(plan.render_cpu);
+    out << "\n";
+    for (size_t i = 0; i < plan.worker_cpus.size(); ++i) {
+        out << "  worker " << i << " -> ";
+        describe_cpu(plan.worker_cpus[i]);
+        out << "\n";
+    }
+    return out.str();
+}
+
+PlacementConfig placement_from_env() {
+    PlacementConfig config;
+    if (const char* mode = std::getenv("FLAPPY_PLACEMENT")) {
+        std::string value = mode;
+        if (value == "physical") {
+            config.mode = PlacementMode::OnePerPhysicalCore;
+        } else if (!value.empty() && value != "none") {
+            std::vector<int> cpus = online_cpus_in(value, CpuTopology::detect());
+            if (cpus.empty()) {
+                std::cerr << "[Placement] Warning: FLAPPY_PLACEMENT=\"" << value
+                          << "\" is not none, physical or a list of online CPUs (e.g. 2-5,8); "
+                          << "leaving workers unpinned" << std::endl;
+            } else {
+                config.mode = PlacementMode::CoreList;
+                config.worker_cpus = std::move(cpus);
+            }
+        }
+    }
+    if (const char* render = std::getenv("FLAPPY_RENDER_CPU")) {
+        std::vector<int> cpu = online_cpus_in(render, CpuTopology::detect());
+        if (cpu.size() == 1) {
+            config.render_cpu = cpu.front();
+        } else {
+            std::cerr << "[Placement] Warning: FLAPPY_RENDER_CPU=\"" << render
+                      << "\" is not an online CPU number; leaving the render thread unpinned" << std::endl;
+        }
+    }
+    return config;
+}
@@ -0,0 +1,105 @@
+/*
+CpuAffinity.h
+CPU topology discovery and thread placement (pinning) for the render
+thread and the ThreadPool workers.
+
+Topology comes from /sys/devices/system/cpu on Linux: which logical CPUs
+exist, which physical core and package each belongs to, and which are SMT
+siblings. Threads are pinned with pthread_setaffinity_np. On other
+platforms (macOS has no hard affinity API) the topology falls back to
+one logical CPU per core and pinning is a no-op that reports failure.
+*/
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LogicalCpu {
+    int cpu = 0;        // OS logical CPU number
+    int core_id = 0;    // physical core within its package
+    int package_id = 0; // socket
+};
+
+class CpuTopology {
+private:
+    std::vector<LogicalCpu> m_cpus;       // online CPUs, by cpu number
+    std::vector<int> m_allowed;           // CPUs this process may run on
+
+public:
+    /**
+     * @brief Reads the topology of the machine this process runs on.
+     */
+    static CpuTopology detect();
+
+    const std::vector<LogicalCpu>& cpus() const { return m_cpus; }
+    const std::vector<int>& allowed_cpus() const { return m_allowed; }
+
+    // The logical CPU entry for `cpu`, or nullptr if it is not online
+    const LogicalCpu* find(int cpu) const;
+
+    // Logical CPUs sharing a physical core with `cpu` (including `cpu` itself)
+    std::vector<int> siblings_of(int cpu) const;
+
+    // The first allowed logical CPU of each physical core
+    std::vector<int> one_per_physical_core() const;
+
+    size_t physical_core_count() const;
+};
+
+enum class PlacementMode {
+    None,              // leave scheduling to the OS
+    CoreList,          // worker i runs on worker_cpus[i % size]
+    OnePerPhysicalCore // one worker per physical core, skipping SMT siblings
+};
+
+struct PlacementConfig {
+    PlacementMode mode = PlacementMode::None;
+    std::vector<int> worker_cpus;      // CoreList only
+    int render_cpu = -1;               // pin the render (calling) thread here; -1 = leave it
+    bool avoid_render_siblings = true; // keep workers off the render CPU's physical core
+};
+
+// Which CPU each thread goes on; -1 means unpinned
+struct PlacementPlan {
+    int render_cpu = -1;
+    std::vector<int> worker_cpus;
+};
+
+/**
+ * @brief Assigns CPUs to the render thread and `num_workers` workers.
+ */
+PlacementPlan plan_placement(const PlacementConfig& config, const CpuTopology& topology, size_t num_workers);
+
+/**
+ * @brief Pins a thread to one logical CPU.
+ * @return False if the platform has no affinity support or the call failed
+ */
+bool pin_thread(std::thread& thread, int cpu);
+bool pin_current_thread(int cpu);
+
+/**
+ * @brief One-line-per-thread description of a plan, e.g. for the startup log.
+ */
+std::string describe_placement(const PlacementPlan& plan, const CpuTopology& topology);
+
+/**
+ * @brief Reads a PlacementConfig from the environment:
+ * FLAPPY_PLACEMENT = none | physical | <cpu list, e.g. 2-5,8>
+ * FLAPPY_RENDER_CPU = <cpu>
+ * A malformed value, or a CPU that is not online, is reported on stderr
+ * and leaves the corresponding threads unpinned.
+ */
+PlacementConfig placement_from_env();
+
+/**
+ * @brief Parses a Linux-style CPU list ("0-3,6,8-9").
+ */
+std::vector<int> parse_cpu_list(const std::string& list);
+
+/**
+ * @brief True if `list` is a well-formed CPU list: comma-separated CPU
+ * numbers or ascending "first-last" ranges, nothing else.
+ */
+bool is_cpu_list(const std::string& list);
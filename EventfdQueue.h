@@ -0,0 +1,262 @@
+/*
+EventfdQueue.h
+A command queue that can be waited on through a file descriptor.
+
+fd() becomes readable when items arrive in an empty queue, so an I/O
+thread can wait on sockets, timers and several command queues in a single
+epoll_wait/poll. Signalling is edge-triggered: only the push that makes
+the queue non-empty writes to the fd. While the consumer is busy draining,
+further pushes cost no syscall; once try_pop finds the queue empty it
+clears the fd and re-arms the signal. The intended consumer loop is:
+
+    epoll_wait(...)                      // fd() readable
+    while (queue.try_pop(command)) ...   // drain; the last call re-arms
+
+Linux uses an eventfd; other platforms fall back to a non-blocking
+self-pipe. The blocking pops wait on the same fd with poll().
+*/
+
+#pragma once
+
+#include <deque>
+#include <span>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <type_traits>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include "QueueCommon.h"
+
+template <typename T>
+class EventfdQueue {
+private:
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::atomic<bool> m_stop{false};
+
+    // True when the next push into an empty queue must signal the fd.
+    // Guarded by m_mutex, as are all writes and drains of the fd.
+    bool m_armed = true;
+    std::atomic<uint64_t> m_signals{0};
+
+    int m_read_fd = -1;
+    int m_write_fd = -1; // same as m_read_fd for an eventfd
+
+    void open_fds() {
+#ifdef __linux__
+        m_read_fd = m_write_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_read_fd < 0) throw std::system_error(errno, std::generic_category(), "eventfd");
+#else
+        int fds[2];
+        if (::pipe(fds) != 0) throw std::system_error(errno, std::generic_category(), "pipe");
+        for (int fd : fds) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        m_read_fd = fds[0];
+        m_write_fd = fds[1];
+#endif
+    }
+
+    // Makes fd() readable; caller must hold m_mutex
+    void signal() {
+#ifdef __linux__
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = ::write(m_write_fd, &one, sizeof(one));
+#else
+        char byte = 1;
+        [[maybe_unused]] ssize_t n = ::write(m_write_fd, &byte, 1);
+#endif
+        m_signals.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Resets fd() to not readable; caller must hold m_mutex
+    void clear_signal() {
+#ifdef __linux__
+        uint64_t count;
+        [[maybe_unused]] ssize_t n = ::read(m_read_fd, &count, sizeof(count));
+#else
+        char buffer[64];
+        while (::read(m_read_fd, buffer, sizeof(buffer)) > 0) {}
+#endif
+    }
+
+    // Called with the queue found empty; caller must hold m_mutex.
+    // A stopped queue keeps its fd readable so every waiter sees the stop.
+    void rearm() {
+        if (m_armed || m_stop) return;
+        clear_signal();
+        m_armed = true;
+    }
+
+    void take_front(T& item) {
+        item = std::move(m_items.front());
+        m_items.pop_front();
+    }
+
+    // Pops up to max items, re-arming if that empties the queue; caller must hold m_mutex
+    size_t take_bulk(std::span<T> out, size_t max) {
+        size_t count = 0;
+        while (count < max && !m_items.empty()) take_front(out[count++]);
+        if (m_items.empty()) rearm();
+        return count;
+    }
+
+    // Blocks in poll() until fd() is readable or the deadline passes
+    template <typename Deadline>
+    void wait_readable(const Deadline& deadline) {
+        int timeout_ms = -1;
+        if constexpr (!std::is_same_v<Deadline, NoDeadline>) {
+            auto remaining = deadline - Deadline::clock::now();
+            auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+            timeout_ms = ms > 0 ? static_cast<int>(std::min<decltype(ms)>(ms, 60000)) : 0;
+        }
+        pollfd pfd{m_read_fd, POLLIN, 0};
+        ::poll(&pfd, 1, timeout_ms);
+    }
+
+    /**
+     * @brief Waits for items and pops up to max of them.
+     * @return Number popped; 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Deadline>
+    size_t wait_and_take(std::span<T> out, size_t max, const Deadline& deadline) {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_items.empty()) return take_bulk(out, max);
+                rearm();
+                if (m_stop || deadline_passed(deadline)) return 0;
+            }
+            wait_readable(deadline);
+        }
+    }
+
+public:
+    EventfdQueue() { open_fds(); }
+
+    ~EventfdQueue() {
+        if (m_write_fd != m_read_fd) ::close(m_write_fd);
+        ::close(m_read_fd);
+    }
+
+    EventfdQueue(const EventfdQueue&) = delete;
+    EventfdQueue& operator=(const EventfdQueue&) = delete;
+
+    /**
+     * @brief Descriptor to register with epoll/poll (EPOLLIN, edge- or level-triggered).
+     * Readable while the queue has items the consumer has not yet drained, and after stop().
+     */
+    int fd() const { return m_read_fd; }
+
+    /**
+     * @brief Push an item, signalling fd() only if the queue was drained and re-armed
+     * @return True if the item was enqueued, false if the queue is stopped
+     */
+    bool push(T item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) return false;
+        m_items.push_back(std::move(item));
+        if (m_armed) {
+            m_armed = false;
+            signal();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Pop an item from the queue
+     * @return True if an item was popped, false if the queue is stopped and empty
+     */
+    bool pop(T& item) {
+        return wait_and_take(std::span<T>(&item, 1), 1, NoDeadline{}) == 1;
+    }
+
+    /**
+     * @brief Pop an item without waiting; re-arms the fd signal when the queue is empty
+     * @return True if an item was popped, false if the queue was empty
+     */
+    bool try_pop(T& item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) {
+            rearm();
+            return false;
+        }
+        return take_bulk(std::span<T>(&item, 1), 1) == 1;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most until the deadline
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_and_take(std::span<T>(&item, 1), 1, deadline) == 1;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most for the given duration
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Pop up to max items under a single lock
+     * Blocks until at least one item is available or the queue is stopped.
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+        return wait_and_take(out, max, NoDeadline{});
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+        return wait_and_take(out, max, deadline);
+    }
+
+    /**
+     * signals queue to stop and leaves fd() readable, so every waiter
+     * (poll, epoll or a blocking pop) wakes up
+    */
+    void stop() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_armed = false;
+        signal();
+    }
+
+    /**
+     * @brief True once stop() has been called (items may still be queued)
+     */
+    bool stopped() const {
+        return m_stop.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of times fd() was signalled; compare with pushes to see
+     * how many wakeups the edge-triggering saved
+     */
+    uint64_t signals() const {
+        return m_signals.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,241 @@
+/*
+FrameGraph.cpp
+Dependency tracking and dispatch for the per-frame stage graph.
+*/
+
+#include "FrameGraph.h"
+#include "ThreadPool.h"
+#include "ThreadArena.h"
+#include <algorithm>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+
+FrameGraph::FrameGraph(ThreadPool& pool, size_t frames_in_flight)
+    : m_pool(pool),
+      m_slots(std::max<size_t>(2, frames_in_flight)) // frame N-1 must keep its slot while N runs
+{
+    m_history.resize(TIMING_HISTORY);
+}
+
+FrameGraph::~FrameGraph() {
+    drain();
+}
+
+FrameGraph::StageId FrameGraph::add_stage(std::string name, StageThread thread, StageFunc func,
+                                          std::vector<StageId> depends_on) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_next_frame > 0) throw std::logic_error("FrameGraph: stages must be added before the first frame");
+
+    const StageId id = m_stages.size();
+    for (StageId dependency : depends_on) {
+        if (dependency >= id) throw std::invalid_argument("FrameGraph: unknown dependency for stage " + name);
+    }
+    for (StageId dependency : depends_on) m_stages[dependency].successors.push_back(id);
+
+    Stage stage;
+    stage.name = std::move(name);
+    stage.thread = thread;
+    stage.func = std::move(func);
+    stage.depends_on = std::move(depends_on);
+    // Never re-entered: frame N's run waits for frame N-1's
+    stage.previous_on.push_back(id);
+    stage.next_successors.push_back(id);
+    m_stages.push_back(std::move(stage));
+    for (FrameTimings& timings : m_history) timings.stages.emplace_back();
+    return id;
+}
+
+void FrameGraph::after_previous_frame(StageId stage, StageId dependency) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_next_frame > 0) throw std::logic_error("FrameGraph: stages must be linked before the first frame");
+    if (stage >= m_stages.size() || dependency >= m_stages.size()) {
+        throw std::invalid_argument("FrameGraph: unknown stage in after_previous_frame");
+    }
+    if (dependency == stage) return; // implicit
+    m_stages[stage].previous_on.push_back(dependency);
+    m_stages[dependency].next_successors.push_back(stage);
+}
+
+void FrameGraph::make_ready(uint64_t frame, StageId stage, ReadyList& ready_pool) {
+    if (m_stages[stage].thread == StageThread::Caller) {
+        m_caller_ready.push_back(ReadyStage{frame, stage});
+        m_cv.notify_all();
+    } else {
+        ready_pool.push_back(ReadyStage{frame, stage});
+    }
+}
+
+void FrameGraph::dispatch(const ReadyList& ready_pool) {
+    for (const ReadyStage& ready : ready_pool) {
+        m_pool.post([this, ready] { run_stage(ready.frame, ready.stage); });
+    }
+}
+
+void FrameGraph::complete(uint64_t frame, StageId stage, std::chrono::steady_clock::time_point start,
+                          std::chrono::steady_clock::time_point end, ReadyList& ready_pool) {
+    FrameSlot& slot = slot_of(frame);
+    StageRun& run = slot.runs[stage];
+    run.done = true;
+    run.timing.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - slot.submitted);
+    run.timing.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+    for (StageId successor : m_stages[stage].successors) {
+        if (--slot.runs[successor].waiting == 0) make_ready(frame, successor, ready_pool);
+    }
+    // If the next frame is already running, its stages counted this one as pending
+    if (m_next_frame > frame + 1) {
+        FrameSlot& next = slot_of(frame + 1);
+        for (StageId successor : m_stages[stage].next_successors) {
+            if (--next.runs[successor].waiting == 0) make_ready(frame + 1, successor, ready_pool);
+        }
+    }
+
+    if (--slot.remaining == 0) {
+        slot.active = false;
+        // Overwrite the oldest entry in place; its stages were sized by add_stage
+        FrameTimings& timings = m_history[m_history_next];
+        m_history_next = (m_history_next + 1) % TIMING_HISTORY;
+        m_history_count = std::min(m_history_count + 1, TIMING_HISTORY);
+        timings.frame = frame;
+        timings.total = std::chrono::duration_cast<std::chrono::nanoseconds>(end - slot.submitted);
+        for (size_t i = 0; i < slot.runs.size(); ++i) timings.stages[i] = slot.runs[i].timing;
+        m_cv.notify_all();
+    }
+}
+
+void FrameGraph::run_stage(uint64_t frame, StageId stage) {
+    // Caller stages do not run inside a pool task, so scope the arena here
+    ArenaScope scope;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        m_stages[stage].func(frame);
+    } catch (const std::exception& e) {
+        // The frame still completes, so later frames are not blocked behind it
+        std::cerr << "[FrameGraph] Warning: stage '" << m_stages[stage].name << "' threw in frame "
+                  << frame << ": " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "[FrameGraph] Warning: stage '" << m_stages[stage].name << "' threw in frame "
+                  << frame << ": unknown exception" << std::endl;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    ReadyList ready_pool(&scope.arena());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        complete(frame, stage, start, end, ready_pool);
+    }
+    dispatch(ready_pool);
+}
+
+template <typename Pred>
+void FrameGraph::run_caller_until(std::unique_lock<std::mutex>& lock, Pred done) {
+    while (!done()) {
+        if (!m_caller_ready.empty()) {
+            ReadyStage ready = m_caller_ready.front();
+            m_caller_ready.pop_front();
+            lock.unlock();
+            run_stage(ready.frame, ready.stage);
+            lock.lock();
+            continue;
+        }
+        m_cv.wait(lock);
+    }
+}
+
+uint64_t FrameGraph::submit_frame() {
+    ArenaScope scope;
+    ReadyList ready_pool(&scope.arena());
+    uint64_t frame;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        frame = m_next_frame;
+        FrameSlot& slot = slot_of(frame);
+        // The slot's previous frame (frame - frames_in_flight) must be done
+        run_caller_until(lock, [&slot] { return !slot.active; });
+
+        slot.frame = frame;
+        slot.submitted = std::chrono::steady_clock::now();
+        slot.runs.assign(m_stages.size(), StageRun{});
+        slot.remaining = m_stages.size();
+        slot.active = slot.remaining > 0;
+        ++m_next_frame;
+
+        const FrameSlot* previous = frame > 0 ? &slot_of(frame - 1) : nullptr;
+        for (StageId stage = 0; stage < m_stages.size(); ++stage) {
+            size_t waiting = m_stages[stage].depends_on.size();
+            if (previous) {
+                for (StageId dependency : m_stages[stage].previous_on) {
+                    if (!previous->runs[dependency].done) ++waiting;
+                }
+            }
+            slot.runs[stage].waiting = waiting;
+        }
+        for (StageId stage = 0; stage < m_stages.size(); ++stage) {
+            if (slot.runs[stage].waiting == 0) make_ready(frame, stage, ready_pool);
+        }
+    }
+    dispatch(ready_pool);
+    return frame;
+}
+
+void FrameGraph::wait_frame(uint64_t frame) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (frame >= m_next_frame) return; // never submitted
+    const FrameSlot& slot = slot_of(frame);
+    // Frames finish in order, so a reused slot means `frame` is long done
+    run_caller_until(lock, [&slot, frame] { return slot.frame != frame || !slot.active; });
+}
+
+void FrameGraph::drain() {
+    uint64_t last;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_next_frame == 0) return;
+        last = m_next_frame - 1;
+    }
+    wait_frame(last);
+}
+
+std::vector<FrameTimings> FrameGraph::recent_timings() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Oldest first: until the ring is full it starts at 0, then at m_history_next
+    if (m_history_count < TIMING_HISTORY) {
+        return std::vector<FrameTimings>(m_history.begin(), m_history.begin() + m_history_count);
+    }
+    std::vector<FrameTimings> timings(m_history.begin() + m_history_next, m_history.end());
+    timings.insert(timings.end(), m_history.begin(), m_history.begin() + m_history_next);
+    return timings;
+}
+
+std::string FrameGraph::summarize_timings() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+    if (m_history_count == 0) return out.str();
+
+    // Order does not matter here; until the ring is full the entries are [0, count)
+    const auto recorded = std::span<const FrameTimings>(m_history).first(m_history_count);
+    auto us = [](std::chrono::nanoseconds ns) { return ns.count() / 1000; };
+    const auto frames = static_cast<std::chrono::nanoseconds::rep>(m_history_count);
+    for (StageId stage = 0; stage < m_stages.size(); ++stage) {
+        std::chrono::nanoseconds sum{0};
+        std::chrono::nanoseconds worst{0};
+        for (const FrameTimings& timings : recorded) {
+            sum += timings.stages[stage].duration;
+            worst = std::max(worst, timings.stages[stage].duration);
+        }
+        out << "  " << m_stages[stage].name
+            << (m_stages[stage].thread == StageThread::Caller ? " (caller)" : " (pool)")
+            << ": mean " << us(sum / frames) << "us, max " << us(worst) << "us\n";
+    }
+    std::chrono::nanoseconds sum{0};
+    std::chrono::nanoseconds worst{0};
+    for (const FrameTimings& timings : recorded) {
+        sum += timings.total;
+        worst = std::max(worst, timings.total);
+    }
+    out << "  frame (submit to done): mean " << us(sum / frames) << "us, max " << us(worst)
+        << "us over " << m_history_count << " frames\n";
+    return out.str();
+}
@@ -0,0 +1,183 @@
+/*
+FrameGraph.h
+Runs each frame as a graph of stages on the ThreadPool.
+
+Stages are declared once with their dependencies and the graph is reused
+for every frame. A stage runs either on the pool's task workers or on the
+thread that drives the graph (the "caller", e.g. the SFML thread, which
+must do input polling and drawing itself). Besides its dependencies
+within the frame, a stage can wait for a stage of the previous frame,
+and every stage implicitly waits for its own previous run, so stages are
+never re-entered.
+
+Up to `frames_in_flight` frames run at once. With
+    input -> physics -> snapshot -> render_prep -> draw
+and physics(N+1) waiting only for snapshot(N), render_prep and draw of
+frame N overlap physics of frame N+1.
+
+The start and duration of every stage is recorded per frame; the most
+recent frames are kept for recent_timings() and summarize_timings().
+
+Every stage runs inside an ArenaScope, so stages can take per-frame
+scratch from thread_arena(). Once warmed up, the graph's own bookkeeping
+does not touch the global heap either.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+struct StageTiming {
+    std::chrono::nanoseconds start{0};    // since the frame was submitted
+    std::chrono::nanoseconds duration{0};
+};
+
+struct FrameTimings {
+    uint64_t frame = 0;
+    std::chrono::nanoseconds total{0};    // submit -> last stage done
+    std::vector<StageTiming> stages;      // indexed by StageId
+};
+
+class FrameGraph {
+public:
+    using StageId = size_t;
+    using StageFunc = std::function<void(uint64_t frame)>;
+
+    enum class StageThread {
+        Pool,   // a ThreadPool task worker
+        Caller  // the thread calling submit_frame()/wait_frame()
+    };
+
+private:
+    static constexpr size_t TIMING_HISTORY = 240; // frames kept for reporting
+
+    struct Stage {
+        std::string name;
+        StageThread thread;
+        StageFunc func;
+        std::vector<StageId> depends_on;       // same frame
+        std::vector<StageId> successors;       // same frame
+        std::vector<StageId> previous_on;      // previous frame (incl. itself)
+        std::vector<StageId> next_successors;  // next frame (incl. itself)
+    };
+
+    struct StageRun {
+        size_t waiting = 0; // unfinished dependencies
+        bool done = false;
+        StageTiming timing;
+    };
+
+    struct FrameSlot {
+        uint64_t frame = 0;
+        bool active = false;
+        size_t remaining = 0; // stages not yet done
+        std::chrono::steady_clock::time_point submitted;
+        std::vector<StageRun> runs;
+    };
+
+    struct ReadyStage {
+        uint64_t frame;
+        StageId stage;
+    };
+    using ReadyList = std::pmr::vector<ReadyStage>; // scratch, on the thread arena
+
+    ThreadPool& m_pool;
+    std::vector<Stage> m_stages;
+    std::vector<FrameSlot> m_slots; // frame N uses slot N % frames_in_flight
+    uint64_t m_next_frame = 0;
+
+    // All bookkeeping is under m_mutex; stages themselves run unlocked
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv; // a caller stage is ready or a frame completed
+    std::pmr::unsynchronized_pool_resource m_queue_memory; // recycles m_caller_ready's blocks
+    std::pmr::deque<ReadyStage> m_caller_ready{&m_queue_memory};
+    // Ring of TIMING_HISTORY frames, sized up front (one StageTiming per
+    // stage is added by add_stage), so recording a frame never allocates
+    std::vector<FrameTimings> m_history;
+    size_t m_history_next = 0;  // oldest entry once the ring is full
+    size_t m_history_count = 0; // entries recorded so far, at most TIMING_HISTORY
+
+    FrameSlot& slot_of(uint64_t frame) { return m_slots[frame % m_slots.size()]; }
+
+    // Bookkeeping for a finished stage (m_mutex held); collects stages it made ready
+    void complete(uint64_t frame, StageId stage, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end, ReadyList& ready_pool);
+
+    // Queues a ready stage: caller stages on m_caller_ready, pool stages in `ready_pool`
+    void make_ready(uint64_t frame, StageId stage, ReadyList& ready_pool);
+
+    void dispatch(const ReadyList& ready_pool);
+
+    // Runs one stage (on whichever thread) and completes it
+    void run_stage(uint64_t frame, StageId stage);
+
+    // Runs caller stages on this thread until `done` holds (m_mutex held)
+    template <typename Pred>
+    void run_caller_until(std::unique_lock<std::mutex>& lock, Pred done);
+
+public:
+    /**
+     * @brief Creates an empty graph.
+     * @param pool Runs the StageThread::Pool stages.
+     * @param frames_in_flight Frames that may run at once (at least 2 to overlap frames).
+     */
+    explicit FrameGraph(ThreadPool& pool, size_t frames_in_flight = 2);
+
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Waits for every submitted frame
+    ~FrameGraph();
+
+    /**
+     * @brief Declares a stage. Dependencies must already exist, so the graph is acyclic.
+     * Stages can only be added before the first frame is submitted.
+     * @throws std::invalid_argument on an unknown dependency
+     * @throws std::logic_error once frames have been submitted
+     */
+    StageId add_stage(std::string name, StageThread thread, StageFunc func, std::vector<StageId> depends_on = {});
+
+    /**
+     * @brief Makes `stage` of frame N wait for `dependency` of frame N-1,
+     * e.g. physics(N) after snapshot(N-1) has copied the state it is about to change.
+     */
+    void after_previous_frame(StageId stage, StageId dependency);
+
+    /**
+     * @brief Starts the next frame. If `frames_in_flight` frames are already
+     * running, first runs caller stages until the oldest has finished.
+     * @return The frame number
+     */
+    uint64_t submit_frame();
+
+    /**
+     * @brief Runs caller stages on this thread until `frame` has finished.
+     */
+    void wait_frame(uint64_t frame);
+
+    // Waits for every submitted frame
+    void drain();
+
+    size_t stage_count() const { return m_stages.size(); }
+    const std::string& stage_name(StageId stage) const { return m_stages[stage].name; }
+
+    /**
+     * @brief Timings of the most recently finished frames, oldest first.
+     */
+    std::vector<FrameTimings> recent_timings() const;
+
+    /**
+     * @brief Mean and worst duration per stage over recent frames, one line per stage.
+     */
+    std::string summarize_timings() const;
+};
@@ -7,12 +7,19 @@ Defines the shared, thread-safe game world state for Flappy Bird.
 
 #include <mutex>
 #include <vector>
+#include <memory_resource>
+#include <span>
 #include <iostream>
 #include <random>
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <variant>
+#include <atomic>
 #include <SFML/Graphics.hpp>
 #include "PlayerCommand.h" // Forward declaration wouldn't work, need full definition
+#include "ThreadPool.h"    // parallel_for / parallel_reduce over entities
+#include "TickExecutor.h"  // coroutine timers (pipe spawning)
 
 // --- RENDER CONSTANTS ---
 const float WINDOW_WIDTH = 800.0f;
@@ -28,6 +35,23 @@ const float GRAVITY = -40.0f;       // Stronger gravity for faster fall
 const float FLAP_VELOCITY = 15.0f; // Instant upward velocity on flap
 const float BIRD_RADIUS = 1.0f;     // World size of the bird (used for collision)
 
+// Commands applied later than this after input are reported as late
+const long long LATE_COMMAND_US = 1000;
+
+// Entity count from which physics and collision are split across the pool;
+// below it, task hand-off costs more than the loop itself
+const size_t PARALLEL_ENTITY_THRESHOLD = 512;
+
+// Pipe spawn interval in physics steps (1.8 s at the 60 Hz fixed step)
+const uint64_t PIPE_SPAWN_TICKS = 108;
+
+// How long Hover keeps the bird from falling, in physics steps (0.5 s at 60 Hz)
+const uint64_t HOVER_TICKS = 30;
+
+// Pipe capacity reserved up front (about 4 are on screen at once), so
+// spawning does not allocate in steady state
+const size_t RESERVED_PIPES = 16;
+
 // --- GAME ENTITIES ---
 
 struct PipeState {
@@ -47,43 +71,202 @@ struct BirdState {
     int score = 0;
 };
 
+// Copy of the state one rendered frame needs (see GameState::snapshot)
+struct GameSnapshot {
+    BirdState bird;
+    std::pmr::vector<PipeState> pipes;
+
+    explicit GameSnapshot(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : pipes(resource) {
+        pipes.reserve(RESERVED_PIPES);
+    }
+};
+
 
 class GameState {
 private:
     mutable std::mutex m_mutex; // Must be mutable for const methods to lock it
     BirdState m_bird;
-    std::vector<PipeState> m_pipes;
+    std::pmr::vector<PipeState> m_pipes; // lives as long as the GameState: never a thread arena
     float m_pipe_spawn_timer = 0.0f;
+    bool m_paused = false;
     std::default_random_engine m_rng{std::random_device{}()};
+
+    // Late-command tracking; reported by flush_latency_warnings() so that no
+    // console I/O happens while m_mutex is held
+    uint64_t m_late_commands = 0;
+    long long m_worst_latency_us = 0;
+
+    // Time callers spent blocked on m_mutex in lock_timed: on the command
+    // workers' paths only (see lock_wait_ns), and on every path
+    mutable std::atomic<uint64_t> m_command_lock_wait_ns{0};
+    mutable std::atomic<uint64_t> m_total_lock_wait_ns{0};
+
+    // Optional pool for parallel entity updates (see set_thread_pool)
+    ThreadPool* m_thread_pool = nullptr;
+
+    // Optional game-time scheduler; update_physics advances it once per step
+    TickExecutor* m_scheduler = nullptr;
+
+    // Abilities handed to the run_abilities coroutine, once attach_scheduler started it
+    AwaitableQueue<Ability> m_abilities;
+    std::atomic<bool> m_ability_coroutine{false};
     
+    // Who is taking m_mutex: adaptive sizing compares the command workers'
+    // wait with their own busy time, so other stages must not count there
+    enum class LockPath {
+        Commands, // run by the command/shard workers
+        Other     // physics and snapshot stages, room ticks, the renderer
+    };
+
+    // Locks m_mutex, timing the wait when it is contended, so the worker
+    // metrics see every stage that queues on this lock
+    std::unique_lock<std::mutex> lock_timed(LockPath path) const {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            const auto ns = static_cast<uint64_t>(waited.count());
+            if (path == LockPath::Commands) m_command_lock_wait_ns.fetch_add(ns, std::memory_order_relaxed);
+            m_total_lock_wait_ns.fetch_add(ns, std::memory_order_relaxed);
+            record_worker_lock_wait(waited);
+        }
+        return lock;
+    }
+
     // Helper function to convert world Y to screen Y
-    float world_to_screen_y(float world_y) const {
+    static float world_to_screen_y(float world_y) {
         // In SFML, Y=0 is the top, so we must invert the Y axis and scale.
         return WINDOW_HEIGHT - (world_y * SCALE_FACTOR);
     }
 
+    void add_pipe() {
+        std::uniform_real_distribution<float> y_dist(5.0f, 15.0f);
+        m_pipes.push_back({
+            GAME_WIDTH, // Start far right
+            y_dist(m_rng), // Random center gap Y
+            6.0f, // Fixed gap size (in world units)
+            false
+        });
+    }
+
+    // Accumulator-driven spawning, used when no TickExecutor is attached
     void spawn_pipe(float dt) {
         m_pipe_spawn_timer += dt;
         if (m_pipe_spawn_timer >= 1.8f) { // Spawn a new pipe every 1.8 seconds
-            std::uniform_real_distribution<float> y_dist(5.0f, 15.0f);
-            m_pipes.push_back({
-                GAME_WIDTH, // Start far right
-                y_dist(m_rng), // Random center gap Y
-                6.0f, // Fixed gap size (in world units)
-                false
-            });
+            add_pipe();
             m_pipe_spawn_timer = 0.0f;
         }
     }
 
-    bool check_collision() {
-        // Ground/Ceiling check (world Y is 0 to 20)
-        if (m_bird.y <= BIRD_RADIUS || m_bird.y >= 20.0f - BIRD_RADIUS) { 
-            return true;
+    // Coroutine spawning: sleeps on the executor between pipes instead of
+    // being polled every tick
+    GameTask run_pipe_spawner(TickExecutor& scheduler) {
+        for (;;) {
+            co_await scheduler.sleep_for(PIPE_SPAWN_TICKS);
+            auto lock = lock_timed(LockPath::Other);
+            if (m_bird.is_alive && !m_paused) add_pipe();
         }
+    }
 
-        // Pipe collision check
-        for (const auto& pipe : m_pipes) {
+    // Effects that last several ticks: waits for abilities handed over by
+    // process_commands and holds each one for its duration in game time
+    GameTask run_abilities(TickExecutor& scheduler) {
+        while (std::optional<Ability> ability = co_await command_from(m_abilities)) {
+            switch (ability->id) {
+            case AbilityId::Hover:
+                for (uint64_t tick = 0; tick < HOVER_TICKS; ++tick) {
+                    {
+                        auto lock = lock_timed(LockPath::Other);
+                        if (!m_bird.is_alive || m_paused) break;
+                        m_bird.y_vel = std::max(m_bird.y_vel, 0.0f); // no falling; flaps still work
+                    }
+                    co_await scheduler.next_tick();
+                }
+                break;
+            }
+        }
+    }
+
+    // Gives Ability commands to run_abilities, if it runs. Call without
+    // m_mutex: handing one over resumes the coroutine, which takes the lock
+    void hand_off_abilities(std::span<const PlayerCommand> commands) {
+        if (!m_ability_coroutine.load(std::memory_order_acquire)) return;
+        for (const auto& command : commands) {
+            if (const Ability* ability = std::get_if<Ability>(&command.action)) m_abilities.push(*ability);
+        }
+    }
+
+    // --- Command handlers, one per CommandAction alternative; caller must hold m_mutex ---
+
+    void apply(const NoAction&) {}
+
+    void apply(const Flap&) {
+        if (m_bird.is_alive && !m_paused) {
+            m_bird.y_vel = FLAP_VELOCITY;
+        }
+    }
+
+    void apply(const Join&) {
+        if (m_bird.is_alive) return;
+        m_bird = BirdState{};
+        m_pipes.clear();
+        m_pipe_spawn_timer = 0.0f;
+        m_paused = false;
+    }
+
+    void apply(const Leave&) {
+        m_bird.is_alive = false;
+    }
+
+    void apply(const Pause& pause) {
+        m_paused = pause.paused;
+    }
+
+    void apply(const Ability& ability) {
+        if (!m_bird.is_alive || m_paused) return;
+        switch (ability.id) {
+        case AbilityId::Hover:
+            m_bird.y_vel = 0.0f;
+            break;
+        }
+    }
+
+    // Applies one command; caller must hold m_mutex
+    void apply_command(const PlayerCommand& command) {
+        std::visit([this](const auto& action) { apply(action); }, command.action);
+
+        // Latency measurement is still critical for a low-latency project
+        auto now = std::chrono::high_resolution_clock::now();
+        auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(now - command.timestamp).count();
+        if (latency_us > LATE_COMMAND_US) {
+            ++m_late_commands;
+            m_worst_latency_us = std::max(m_worst_latency_us, static_cast<long long>(latency_us));
+        }
+    }
+
+    // Moves pipes [begin, end) and marks the ones the bird has passed
+    // @return Number of pipes newly passed (points scored)
+    int move_pipes(size_t begin, size_t end, float dt) {
+        int passed = 0;
+        for (size_t i = begin; i < end; ++i) {
+            auto& pipe = m_pipes[i];
+            pipe.x += PIPE_SPEED * dt;
+            
+            // Score check 
+            if (!pipe.passed && pipe.x < m_bird.x) {
+                ++passed;
+                pipe.passed = true;
+            }
+        }
+        return passed;
+    }
+
+    // True if the bird overlaps any pipe in [begin, end)
+    bool hits_pipe(size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& pipe = m_pipes[i];
             float pipe_width = 4.0f; // World width of pipe
             
             // X-axis check (is bird inside the pipe's horizontal bounds)
@@ -100,71 +283,165 @@ private:
         return false;
     }
 
+    bool parallel_entities() const {
+        return m_thread_pool && m_pipes.size() >= PARALLEL_ENTITY_THRESHOLD;
+    }
+
+    bool check_collision() {
+        // Ground/Ceiling check (world Y is 0 to 20)
+        if (m_bird.y <= BIRD_RADIUS || m_bird.y >= 20.0f - BIRD_RADIUS) { 
+            return true;
+        }
+
+        // Pipe collision check
+        if (parallel_entities()) {
+            return m_thread_pool->parallel_reduce(size_t{0}, m_pipes.size(), false,
+                [this](size_t begin, size_t end) { return hits_pipe(begin, end); },
+                [](bool a, bool b) { return a || b; });
+        }
+        return hits_pipe(0, m_pipes.size());
+    }
+
 public:
+    /**
+     * @brief `resource` backs the pipe list; it must outlive the GameState.
+     * Rooms can share a pool resource instead of each hitting the global heap.
+     */
+    explicit GameState(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_pipes(resource) {
+        m_pipes.reserve(RESERVED_PIPES);
+    }
+
+    /**
+     * @brief Lets update_physics split large entity sets across the pool's
+     * task workers. The pool must outlive its use here (or be reset to nullptr).
+     */
+    void set_thread_pool(ThreadPool* pool) {
+        auto lock = lock_timed(LockPath::Other);
+        m_thread_pool = pool;
+    }
+
+    /**
+     * @brief Moves timed logic onto `scheduler`: pipes are spawned by a
+     * coroutine, abilities with a duration (Hover) are held by another, and
+     * every update_physics step advances it by one tick.
+     * The scheduler must be destroyed before the GameState.
+     */
+    void attach_scheduler(TickExecutor& scheduler) {
+        {
+            auto lock = lock_timed(LockPath::Other);
+            m_scheduler = &scheduler;
+        }
+        scheduler.spawn(run_pipe_spawner(scheduler));
+        scheduler.spawn(run_abilities(scheduler));
+        m_ability_coroutine.store(true, std::memory_order_release);
+    }
+
     // --- Physics and Logic Updates ---
 
     /**
-     * @brief The consumer task: applies the FLAP command by setting upward velocity.
+     * @brief The consumer task: applies one command (e.g. FLAP sets upward velocity).
      */
     void process_command(const PlayerCommand& command) {
+        hand_off_abilities(std::span<const PlayerCommand>(&command, 1));
         // Normal locking - workers will exit cleanly when queue stops
-        std::lock_guard<std::mutex> lock(m_mutex); 
-        
-        if (command.type == ActionType::FLAP && m_bird.is_alive) {
-            m_bird.y_vel = FLAP_VELOCITY; 
-        }
+        auto lock = lock_timed(LockPath::Commands);
+        apply_command(command);
+    }
 
-        // Latency measurement is still critical for a low-latency project
-        auto now = std::chrono::high_resolution_clock::now();
-        auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(now - command.timestamp).count();
-        if (latency_us > 1000) { 
-            std::cout << "\n[WARN] Flap command latency: " << latency_us << "us\n";
+    /**
+     * @brief Applies a whole batch of commands under a single m_mutex acquisition.
+     */
+    void process_commands(std::span<const PlayerCommand> commands) {
+        hand_off_abilities(commands);
+        auto lock = lock_timed(LockPath::Commands);
+        for (const auto& command : commands) {
+            apply_command(command);
         }
     }
     
+    /**
+     * @brief Cumulative nanoseconds the command workers spent waiting for
+     * m_mutex (command batches and latency flushes). This is the adaptive
+     * sizing probe, since it matches the busy time the sizer divides it by.
+     */
+    uint64_t lock_wait_ns() const { return m_command_lock_wait_ns.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Cumulative nanoseconds spent waiting for m_mutex on every path:
+     * commands plus physics steps (room ticks included), the pipe spawner,
+     * snapshots, the render-side getters and setup.
+     */
+    uint64_t total_lock_wait_ns() const { return m_total_lock_wait_ns.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Prints (and resets) the late-command summary gathered since the last call.
+     * Called periodically by the workers as housekeeping, outside the hot path.
+     */
+    void flush_latency_warnings() {
+        uint64_t late;
+        long long worst;
+        {
+            auto lock = lock_timed(LockPath::Commands); // housekeeping on the command workers
+            late = m_late_commands;
+            worst = m_worst_latency_us;
+            m_late_commands = 0;
+            m_worst_latency_us = 0;
+        }
+        if (late > 0) {
+            std::cout << "\n[WARN] " << late << " command(s) over " << LATE_COMMAND_US
+                      << "us, worst latency: " << worst << "us\n";
+        }
+    }
+
     /**
      * @brief The main loop task: updates position, gravity, and checks collision.
      */
     void update_physics(float dt) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (!m_bird.is_alive) return;
-
-        // 1. Apply Bird Physics (Vertical)
-        m_bird.y_vel += GRAVITY * dt;
-        // Limit maximum falling speed (most negative velocity)
-        const float MAX_FALL_SPEED = -50.0f;
-        m_bird.y_vel = std::max(m_bird.y_vel, MAX_FALL_SPEED);
-        m_bird.y += m_bird.y_vel * dt;
-
-        // 2. Apply Pipe Movement (Horizontal)
-        for (auto& pipe : m_pipes) {
-            pipe.x += PIPE_SPEED * dt;
-            
-            // Score check 
-            if (!pipe.passed && pipe.x < m_bird.x) {
-                m_bird.score++;
-                pipe.passed = true;
+        TickExecutor* scheduler = nullptr;
+        {
+            auto lock = lock_timed(LockPath::Other);
+            if (!m_bird.is_alive || m_paused) return;
+
+            // 1. Apply Bird Physics (Vertical)
+            m_bird.y_vel += GRAVITY * dt;
+            // Limit maximum falling speed (most negative velocity)
+            const float MAX_FALL_SPEED = -50.0f;
+            m_bird.y_vel = std::max(m_bird.y_vel, MAX_FALL_SPEED);
+            m_bird.y += m_bird.y_vel * dt;
+
+            // 2. Apply Pipe Movement (Horizontal) and score passed pipes
+            if (parallel_entities()) {
+                m_bird.score += m_thread_pool->parallel_reduce(size_t{0}, m_pipes.size(), 0,
+                    [this, dt](size_t begin, size_t end) { return move_pipes(begin, end, dt); },
+                    [](int a, int b) { return a + b; });
+            } else {
+                m_bird.score += move_pipes(0, m_pipes.size(), dt);
             }
-        }
 
-        // 3. Spawn and Cleanup Pipes
-        spawn_pipe(dt);
-        m_pipes.erase(
-            std::remove_if(m_pipes.begin(), m_pipes.end(), 
-                           [](const PipeState& p) { return p.x < -10.0f; }),
-            m_pipes.end()
-        );
+            // 3. Spawn and Cleanup Pipes
+            if (!m_scheduler) spawn_pipe(dt);
+            m_pipes.erase(
+                std::remove_if(m_pipes.begin(), m_pipes.end(), 
+                               [](const PipeState& p) { return p.x < -10.0f; }),
+                m_pipes.end()
+            );
 
-        // 4. Collision Check
-        if (check_collision()) {
-            m_bird.is_alive = false;
+            // 4. Collision Check
+            if (check_collision()) {
+                m_bird.is_alive = false;
+            }
+            scheduler = m_scheduler;
         }
+
+        // Resume coroutines due this step; outside m_mutex, since they take it
+        if (scheduler) scheduler->tick();
     }
 
     // For rendering and score display
     BirdState get_bird_state() const {
         try {
-            std::lock_guard<std::mutex> lock(m_mutex);
+            auto lock = lock_timed(LockPath::Other);
             return m_bird;
         } catch (const std::system_error& e) {
             std::cerr << "[GameState] Warning: Mutex error in get_bird_state: " << e.what() << std::endl;
@@ -172,20 +449,22 @@ public:
             return BirdState{};
         }
     }
-    std::vector<PipeState> get_pipe_state() const {
+    // Pass thread_arena() for a per-frame copy that costs no heap allocation
+    std::pmr::vector<PipeState> get_pipe_state(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+        std::pmr::vector<PipeState> pipes(resource);
         try {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            return m_pipes;
+            auto lock = lock_timed(LockPath::Other);
+            pipes.assign(m_pipes.begin(), m_pipes.end());
         } catch (const std::system_error& e) {
             std::cerr << "[GameState] Warning: Mutex error in get_pipe_state: " << e.what() << std::endl;
-            return std::vector<PipeState>{};
         }
+        return pipes;
     }
     
     // SFML Drawing Helpers
     float bird_screen_y() const {
         try {
-            std::lock_guard<std::mutex> lock(m_mutex);
+            auto lock = lock_timed(LockPath::Other);
             return world_to_screen_y(m_bird.y) - BIRD_DRAW_SIZE / 2.0f;
         } catch (const std::system_error& e) {
             std::cerr << "[GameState] Warning: Mutex error in bird_screen_y: " << e.what() << std::endl;
@@ -193,44 +472,66 @@ public:
         }
     }
 
+    /**
+     * @brief Copies everything the renderer needs under one lock.
+     * Reuses `out`'s pipe storage, so steady-state snapshots do not allocate.
+     */
+    void snapshot(GameSnapshot& out) const {
+        try {
+            auto lock = lock_timed(LockPath::Other);
+            out.bird = m_bird;
+            out.pipes.assign(m_pipes.begin(), m_pipes.end());
+        } catch (const std::system_error& e) {
+            std::cerr << "[GameState] Warning: Mutex error in snapshot: " << e.what() << std::endl;
+        }
+    }
+
+    /**
+     * @brief Builds the top and bottom pipe rectangles for `pipes` into `shapes`.
+     * Needs no lock, so it can run on a snapshot while physics moves on.
+     */
+    static void build_pipe_shapes(std::span<const PipeState> pipes, std::pmr::vector<sf::RectangleShape>& shapes) {
+        shapes.clear();
+        shapes.reserve(pipes.size() * 2);
+        float pipe_screen_width = 4.0f * SCALE_FACTOR;
+
+        for (const auto& pipe : pipes) {
+            float screen_x = pipe.x * SCALE_FACTOR;
+            float half_gap = pipe.gap_size / 2.0f;
+
+            // --- Top Pipe ---
+            float top_pipe_bottom_y_world = pipe.gap_y + half_gap;
+            float top_pipe_height_world = 20.0f - top_pipe_bottom_y_world;
+
+            sf::RectangleShape top_pipe(sf::Vector2f(pipe_screen_width, top_pipe_height_world * SCALE_FACTOR));
+            top_pipe.setPosition(sf::Vector2f(screen_x, 0.0f)); // Top pipe starts at screen Y=0
+            top_pipe.setFillColor(sf::Color(100, 200, 50)); // Green
+            shapes.push_back(top_pipe);
+
+            // --- Bottom Pipe ---
+            float bottom_pipe_top_y_world = pipe.gap_y - half_gap;
+            float bottom_pipe_height_world = bottom_pipe_top_y_world; // Distance from ground (Y=0)
+
+            sf::RectangleShape bottom_pipe(sf::Vector2f(pipe_screen_width, bottom_pipe_height_world * SCALE_FACTOR));
+
+            // SFML y-coordinate for the top of the bottom pipe
+            float bottom_pipe_screen_y = world_to_screen_y(bottom_pipe_top_y_world);
+
+            bottom_pipe.setPosition(sf::Vector2f(screen_x, bottom_pipe_screen_y));
+            bottom_pipe.setFillColor(sf::Color(100, 200, 50)); // Green
+            shapes.push_back(bottom_pipe);
+        }
+    }
+
     // Convert pipe x/y to screen coordinates for drawing
-    std::vector<sf::RectangleShape> get_drawable_pipes() const {
+    std::pmr::vector<sf::RectangleShape> get_drawable_pipes(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+        std::pmr::vector<sf::RectangleShape> shapes(resource);
         try {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            std::vector<sf::RectangleShape> shapes;
-            
-            float pipe_screen_width = 4.0f * SCALE_FACTOR;
-            
-            for (const auto& pipe : m_pipes) {
-                float screen_x = pipe.x * SCALE_FACTOR;
-                float half_gap = pipe.gap_size / 2.0f;
-                
-                // --- Top Pipe ---
-                float top_pipe_bottom_y_world = pipe.gap_y + half_gap;
-                float top_pipe_height_world = 20.0f - top_pipe_bottom_y_world;
-                
-                sf::RectangleShape top_pipe(sf::Vector2f(pipe_screen_width, top_pipe_height_world * SCALE_FACTOR));
-                top_pipe.setPosition(sf::Vector2f(screen_x, 0.0f)); // Top pipe starts at screen Y=0
-                top_pipe.setFillColor(sf::Color(100, 200, 50)); // Green
-                shapes.push_back(top_pipe);
-
-                // --- Bottom Pipe ---
-                float bottom_pipe_top_y_world = pipe.gap_y - half_gap;
-                float bottom_pipe_height_world = bottom_pipe_top_y_world; // Distance from ground (Y=0)
-                
-                sf::RectangleShape bottom_pipe(sf::Vector2f(pipe_screen_width, bottom_pipe_height_world * SCALE_FACTOR));
-                
-                // SFML y-coordinate for the top of the bottom pipe
-                float bottom_pipe_screen_y = world_to_screen_y(bottom_pipe_top_y_world); 
-                
-                bottom_pipe.setPosition(sf::Vector2f(screen_x, bottom_pipe_screen_y));
-                bottom_pipe.setFillColor(sf::Color(100, 200, 50)); // Green
-                shapes.push_back(bottom_pipe);
-            }
-            return shapes;
+            auto lock = lock_timed(LockPath::Other);
+            build_pipe_shapes(m_pipes, shapes);
         } catch (const std::system_error& e) {
             std::cerr << "[GameState] Warning: Mutex error in get_drawable_pipes: " << e.what() << std::endl;
-            return std::vector<sf::RectangleShape>{};
         }
+        return shapes;
     }
 };
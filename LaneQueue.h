@@ -0,0 +1,315 @@
+/*
+LaneQueue.h
+Multi-lane command queue with strict or weighted priority between lanes.
+
+Each lane is a separate FIFO with its own capacity and overflow policy, so
+a flood of low-value traffic (telemetry, bulk sync) can only fill its own
+lane and never pushes gameplay input out or delays it beyond its share.
+Consumers pick the next lane either strictly by priority (lane 0 first)
+or by weighted round-robin, where each lane gets `weight` pops per round
+while it has items and no non-empty lane is ever starved.
+*/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+#include "SafeQueue.h" // OverflowPolicy, TimestampedItem
+#include "QueueCommon.h"
+
+enum class LaneScheduling {
+    Strict,  // always serve the lowest-numbered non-empty lane
+    Weighted // weighted round-robin: lane i gets up to weight[i] pops per round
+};
+
+struct LaneConfig {
+    size_t capacity = 0;                         // 0 = unbounded
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    std::chrono::microseconds max_age{0};        // staleness deadline for DropStale
+    uint32_t weight = 1;                         // pops per round under LaneScheduling::Weighted
+};
+
+template <typename T, typename LaneFn>
+class LaneQueue {
+private:
+    struct Lane {
+        LaneConfig config;
+        std::deque<T> items;
+        uint32_t credits = 0;
+        QueueDropCounters drops; // guarded by m_mutex
+    };
+
+    std::vector<Lane> m_lanes;
+    LaneScheduling m_scheduling;
+    LaneFn m_lane_fn;
+    size_t m_size = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_not_full; // producers blocked by OverflowPolicy::Block
+    std::atomic<bool> m_stop{false};
+
+    // Told about every accepted item a lane discards itself (see set_discard_handler)
+    std::function<void(const T&)> m_on_discard;
+
+    bool full(const Lane& lane) const {
+        return lane.config.capacity > 0 && lane.items.size() >= lane.config.capacity;
+    }
+
+    bool is_stale(const Lane& lane, const T& item) const {
+        if constexpr (TimestampedItem<T>) {
+            using Clock = typename decltype(item.timestamp)::clock;
+            return Clock::now() - item.timestamp > lane.config.max_age;
+        } else {
+            return false;
+        }
+    }
+
+    // Drops a lane's front item after reporting it to the discard handler; caller must hold m_mutex
+    void discard_front(Lane& lane) {
+        if (m_on_discard) m_on_discard(lane.items.front());
+        lane.items.pop_front();
+        --m_size;
+    }
+
+    // Discards stale items from the front of a DropStale lane; caller must hold m_mutex
+    void discard_stale(Lane& lane) {
+        if (lane.config.overflow != OverflowPolicy::DropStale) return;
+        while (!lane.items.empty() && is_stale(lane, lane.items.front())) {
+            discard_front(lane);
+            ++lane.drops.dropped_stale;
+        }
+    }
+
+    /**
+     * @brief Picks the lane to serve next; caller must hold m_mutex and m_size > 0.
+     */
+    Lane& next_lane() {
+        if (m_scheduling == LaneScheduling::Strict) {
+            for (auto& lane : m_lanes) {
+                if (!lane.items.empty()) return lane;
+            }
+        }
+        for (int round = 0; round < 2; ++round) {
+            for (auto& lane : m_lanes) {
+                if (!lane.items.empty() && lane.credits > 0) {
+                    --lane.credits;
+                    return lane;
+                }
+            }
+            // Every non-empty lane has used its share: start a new round
+            for (auto& lane : m_lanes) lane.credits = std::max<uint32_t>(lane.config.weight, 1);
+        }
+        return m_lanes.front(); // unreachable while m_size > 0
+    }
+
+    // Pops the next item by lane priority; caller must hold m_mutex and m_size > 0
+    void take_next(T& item) {
+        Lane& lane = next_lane();
+        item = std::move(lane.items.front());
+        lane.items.pop_front();
+        --m_size;
+    }
+
+    // Pops up to max items; caller must hold m_mutex
+    size_t take_bulk(std::span<T> out, size_t max) {
+        size_t count = 0;
+        while (count < max && m_size > 0) take_next(out[count++]);
+        if (count > 0) m_not_full.notify_all();
+        return count;
+    }
+
+    template <typename Deadline>
+    bool wait_for_items(std::unique_lock<std::mutex>& lock, const Deadline& deadline) {
+        auto ready = [this] { return m_stop || m_size > 0; };
+        for (;;) {
+            for (auto& lane : m_lanes) discard_stale(lane);
+            if (m_size > 0) return true;
+            if (m_stop || deadline_passed(deadline)) return false;
+            if constexpr (std::is_same_v<Deadline, NoDeadline>) {
+                m_condition.wait(lock, ready);
+            } else {
+                m_condition.wait_until(lock, deadline, ready);
+            }
+        }
+    }
+
+public:
+    /**
+     * @brief Constructs the queue.
+     * @param lanes One config per lane; lane 0 has the highest priority.
+     * @param scheduling Strict or weighted priority between lanes.
+     */
+    explicit LaneQueue(std::vector<LaneConfig> lanes,
+                       LaneScheduling scheduling = LaneScheduling::Weighted,
+                       LaneFn lane_fn = LaneFn{})
+        : m_scheduling(scheduling), m_lane_fn(std::move(lane_fn))
+    {
+        for (const auto& config : lanes) {
+            Lane lane;
+            lane.config = config;
+            lane.credits = std::max<uint32_t>(config.weight, 1);
+            m_lanes.push_back(std::move(lane));
+        }
+    }
+
+    /**
+     * @brief Sets a callback for items a lane discards after accepting them:
+     * DropOldest evictions and DropStale expiries. Pushes that return false
+     * are not reported. It runs under the queue lock, so keep it short and do
+     * not touch the queue from it; set it before the queue is shared.
+     */
+    void set_discard_handler(std::function<void(const T&)> handler) {
+        m_on_discard = std::move(handler);
+    }
+
+    /**
+     * @brief Push an item into the lane chosen by LaneFn, applying that lane's overflow policy
+     * @return True if the item was enqueued, false if it was dropped or the queue is stopped
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_stop) return false;
+
+        Lane& lane = m_lanes[std::min<size_t>(m_lane_fn(item), m_lanes.size() - 1)];
+        if (full(lane)) {
+            switch (lane.config.overflow) {
+            case OverflowPolicy::Block:
+                ++lane.drops.blocked_pushes;
+                m_not_full.wait(lock, [this, &lane] { return m_stop || !full(lane); });
+                if (m_stop) return false;
+                break;
+            case OverflowPolicy::DropNewest:
+                ++lane.drops.dropped_newest;
+                return false;
+            case OverflowPolicy::DropOldest:
+                discard_front(lane);
+                ++lane.drops.dropped_oldest;
+                break;
+            case OverflowPolicy::DropStale:
+                discard_stale(lane);
+                if (full(lane)) {
+                    ++lane.drops.dropped_newest;
+                    return false;
+                }
+                break;
+            }
+        }
+
+        lane.items.push_back(std::move(item));
+        ++m_size;
+        m_condition.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop the next item by lane priority
+     * @return True if an item was popped, false if the queue is stopped and empty
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!wait_for_items(lock, NoDeadline{})) return false;
+        take_next(item);
+        m_not_full.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Pop the next item without waiting
+     * @return True if an item was popped, false if every lane was empty
+     */
+    bool try_pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (auto& lane : m_lanes) discard_stale(lane);
+        if (m_size == 0) return false;
+        take_next(item);
+        m_not_full.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Pop the next item, waiting at most until the deadline
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!wait_for_items(lock, deadline)) return false;
+        take_next(item);
+        m_not_full.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Pop the next item, waiting at most for the given duration
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Pop up to max items by lane priority under a single lock
+     * Blocks until at least one item is available or the queue is stopped.
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!wait_for_items(lock, NoDeadline{})) return 0;
+        return take_bulk(out, max);
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!wait_for_items(lock, deadline)) return 0;
+        return take_bulk(out, max);
+    }
+
+    /**
+     * signals queue to stop, wakes up all waiting threads
+    */
+    void stop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_condition.notify_all();
+        m_not_full.notify_all();
+    }
+
+    /**
+     * @brief True once stop() has been called (items may still be queued)
+     */
+    bool stopped() const {
+        return m_stop.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Drop counters for one lane
+     */
+    QueueDropCounters drop_counters(size_t lane) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lanes[lane].drops;
+    }
+
+    size_t lane_count() const { return m_lanes.size(); }
+};
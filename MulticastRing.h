@@ -0,0 +1,301 @@
+/*
+MulticastRing.h
+Disruptor-style pre-allocated ring where every consumer sees every item.
+
+Producers claim a sequence number, write the item directly into its slot
+and publish it. Each consumer owns a cursor (the last sequence it has
+finished with) and may depend on other consumers, e.g. the metrics reader
+only reads a command after the journal writer has persisted it. Consumers
+read items in place through const references: no copies, no per-item
+locks. The producers are gated by the slowest consumer at the end of each
+dependency chain, so a slot is never overwritten while someone still
+needs it.
+
+Consumers must all be registered before the first claim().
+
+stop() fails later claims and any claim still waiting for space; such an
+abandoned claim leaves a hole in the sequence. Consumers then read
+everything claimed before the first hole (waiting for producers that are
+still writing) and return, instead of waiting for sequences that will
+never be published.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "QueueCommon.h"
+
+template <typename T>
+class MulticastRing {
+public:
+    /**
+     * A consumer's position in the ring. Obtained from add_consumer() and
+     * passed back to consume()/wait_for()/release().
+     */
+    class Consumer {
+    private:
+        friend class MulticastRing;
+        alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_cursor{-1}; // last sequence released
+        std::vector<const Consumer*> m_depends_on;
+        bool m_gating = true; // nobody depends on us, so producers wait for us
+
+    public:
+        int64_t cursor() const { return m_cursor.load(std::memory_order_acquire); }
+    };
+
+private:
+    static constexpr int SPIN_LIMIT = 256;
+    static constexpr int YIELD_LIMIT = 16;
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_slots;
+    std::unique_ptr<std::atomic<int64_t>[]> m_published; // sequence last published into each slot
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_claimed{-1};     // highest sequence handed out
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_gating_cache{-1}; // last seen min gating cursor
+    // Lowest sequence given up by a claim that stop() interrupted
+    std::atomic<int64_t> m_abandoned{std::numeric_limits<int64_t>::max()};
+
+    std::deque<Consumer> m_consumers; // deque: stable addresses
+    std::vector<const Consumer*> m_gating;
+
+    // Event count shared by all waiters (consumers waiting for items or
+    // upstream consumers, producers waiting for space)
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_signal{0};
+    std::atomic<uint32_t> m_waiters{0};
+    std::atomic<bool> m_stop{false};
+
+    int64_t min_gating_cursor() const {
+        int64_t min = std::numeric_limits<int64_t>::max();
+        for (const Consumer* consumer : m_gating) {
+            min = std::min(min, consumer->m_cursor.load(std::memory_order_acquire));
+        }
+        return min;
+    }
+
+    /**
+     * @brief Highest sequence `consumer` may read, given what has been
+     * published and how far the consumers it depends on have got.
+     */
+    int64_t available_to(const Consumer& consumer) const {
+        const int64_t next = consumer.m_cursor.load(std::memory_order_relaxed) + 1;
+        int64_t limit = m_claimed.load(std::memory_order_acquire);
+        for (const Consumer* dep : consumer.m_depends_on) {
+            limit = std::min(limit, dep->m_cursor.load(std::memory_order_acquire));
+        }
+        // Multiple producers may publish out of order: stop at the first gap
+        int64_t seq = next;
+        while (seq <= limit && m_published[seq & m_mask].load(std::memory_order_acquire) == seq) ++seq;
+        return seq - 1;
+    }
+
+    // After stop(): the last sequence consumers will see (everything before the first hole)
+    int64_t final_sequence() const {
+        return std::min(m_claimed.load(std::memory_order_acquire),
+                        m_abandoned.load(std::memory_order_acquire) - 1);
+    }
+
+    // Records that [first, ...] will never be published and wakes the consumers
+    void abandon(int64_t first) {
+        int64_t current = m_abandoned.load(std::memory_order_relaxed);
+        while (first < current &&
+               !m_abandoned.compare_exchange_weak(current, first, std::memory_order_acq_rel)) {}
+        signal();
+    }
+
+    // Spin, then yield, then sleep on m_signal until ready() holds
+    template <typename Pred>
+    void wait_until(Pred ready) {
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (ready()) return;
+            cpu_relax();
+        }
+        for (int i = 0; i < YIELD_LIMIT; ++i) {
+            if (ready()) return;
+            std::this_thread::yield();
+        }
+        for (;;) {
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const uint32_t signal = m_signal.load(std::memory_order_seq_cst);
+            if (!ready()) m_signal.wait(signal, std::memory_order_seq_cst);
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (ready()) return;
+        }
+    }
+
+    // Wakes waiters after a cursor moved; free when nobody is sleeping
+    void signal() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_seq_cst) > 0) {
+            m_signal.fetch_add(1, std::memory_order_seq_cst);
+            m_signal.notify_all();
+        }
+    }
+
+public:
+    /**
+     * @brief Constructs the ring.
+     * @param capacity Requested number of slots, rounded up to a power of two.
+     */
+    explicit MulticastRing(size_t capacity = 1024)
+        : m_capacity(round_up_pow2(capacity)),
+          m_mask(m_capacity - 1),
+          m_slots(new T[m_capacity]),
+          m_published(new std::atomic<int64_t>[m_capacity])
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_published[i].store(-1, std::memory_order_relaxed);
+        }
+    }
+
+    MulticastRing(const MulticastRing&) = delete;
+    MulticastRing& operator=(const MulticastRing&) = delete;
+
+    /**
+     * @brief Registers a consumer that reads every item, optionally only
+     * after the given consumers have released it (a dependency barrier).
+     */
+    Consumer& add_consumer(std::initializer_list<const Consumer*> depends_on = {}) {
+        Consumer& consumer = m_consumers.emplace_back();
+        consumer.m_depends_on.assign(depends_on.begin(), depends_on.end());
+        for (const Consumer* dep : depends_on) {
+            const_cast<Consumer*>(dep)->m_gating = false;
+        }
+        m_gating.clear();
+        for (const Consumer& c : m_consumers) {
+            if (c.m_gating) m_gating.push_back(&c);
+        }
+        return consumer;
+    }
+
+    // --- Producer side ---
+
+    /**
+     * @brief Claims the next `count` sequences, waiting while that would
+     * overwrite slots the slowest consumer has not released yet.
+     * @return The last claimed sequence, or -1 if the ring is stopped or
+     * `count` is 0 or more than capacity() (it could never fit)
+     */
+    int64_t claim(size_t count = 1) {
+        if (count == 0 || count > m_capacity) return -1;
+        if (m_stop.load(std::memory_order_acquire)) return -1;
+        const int64_t last = m_claimed.fetch_add(static_cast<int64_t>(count), std::memory_order_acq_rel)
+                           + static_cast<int64_t>(count);
+        const int64_t wrap_point = last - static_cast<int64_t>(m_capacity);
+        if (!m_gating.empty() && wrap_point > m_gating_cache.load(std::memory_order_relaxed)) {
+            wait_until([this, wrap_point] {
+                int64_t min = min_gating_cursor();
+                m_gating_cache.store(min, std::memory_order_relaxed);
+                return wrap_point <= min || m_stop.load(std::memory_order_acquire);
+            });
+            // Stopped while waiting: the slots are still in use, so give up the
+            // claim and tell the consumers not to wait for it
+            if (wrap_point > m_gating_cache.load(std::memory_order_relaxed)) {
+                abandon(last - static_cast<int64_t>(count) + 1);
+                return -1;
+            }
+        }
+        return last;
+    }
+
+    // Slot for a claimed sequence; write the item here before publishing
+    T& operator[](int64_t sequence) { return m_slots[sequence & m_mask]; }
+
+    /**
+     * @brief Makes sequences [first, last] visible to consumers.
+     */
+    void publish(int64_t first, int64_t last) {
+        for (int64_t seq = first; seq <= last; ++seq) {
+            m_published[seq & m_mask].store(seq, std::memory_order_release);
+        }
+        signal();
+    }
+
+    void publish(int64_t sequence) { publish(sequence, sequence); }
+
+    /**
+     * @brief Convenience claim + write + publish of a single item.
+     * @return False if the ring is stopped
+     */
+    bool push(T item) {
+        int64_t seq = claim();
+        if (seq < 0) return false;
+        (*this)[seq] = std::move(item);
+        publish(seq);
+        return true;
+    }
+
+    // --- Consumer side ---
+
+    /**
+     * @brief Waits until `sequence` is readable by `consumer`.
+     * @return The highest readable sequence (>= sequence), or less than
+     * `sequence` if the ring was stopped with nothing more to read
+     */
+    int64_t wait_for(const Consumer& consumer, int64_t sequence) {
+        int64_t available = available_to(consumer);
+        if (available >= sequence) return available;
+        // Once stopped, wait only for claims that will still be published
+        wait_until([&] {
+            available = available_to(consumer);
+            return available >= sequence ||
+                   (m_stop.load(std::memory_order_acquire) && available >= final_sequence());
+        });
+        return available;
+    }
+
+    // Reads a published slot in place
+    const T& get(int64_t sequence) const { return m_slots[sequence & m_mask]; }
+
+    /**
+     * @brief Marks everything up to `sequence` as done for `consumer`, which
+     * frees those slots for producers and unblocks dependent consumers.
+     */
+    void release(Consumer& consumer, int64_t sequence) {
+        consumer.m_cursor.store(sequence, std::memory_order_release);
+        signal();
+    }
+
+    /**
+     * @brief Consumer loop: hands every item to `handler(item, sequence,
+     * end_of_batch)` in order, releasing once per batch, until the ring is
+     * stopped and everything published has been consumed.
+     */
+    template <typename Handler>
+    void consume(Consumer& consumer, Handler handler) {
+        int64_t next = consumer.cursor() + 1;
+        for (;;) {
+            const int64_t available = wait_for(consumer, next);
+            if (available < next) return; // stopped and drained
+            for (int64_t seq = next; seq <= available; ++seq) {
+                handler(get(seq), seq, seq == available);
+            }
+            release(consumer, available);
+            next = available + 1;
+        }
+    }
+
+    /**
+     * signals the ring to stop: further claims (and claims still waiting for
+     * space) fail, and consumers return from consume() once they have read
+     * everything claimed before the first abandoned sequence
+    */
+    void stop() {
+        m_stop.store(true, std::memory_order_release);
+        m_signal.fetch_add(1, std::memory_order_seq_cst);
+        m_signal.notify_all();
+    }
+
+    size_t capacity() const { return m_capacity; }
+};
@@ -0,0 +1,134 @@
+/*
+PhaseBarrier.h
+Sense-reversing barrier for a fixed group of threads that advance in
+lockstep: every participant finishes phase N before any starts N+1.
+
+Each arrival decrements a shared counter. The last one resets it, runs the
+optional completion step and flips the shared sense, which releases the
+others; nobody needs per-thread state, because the sense a thread waits
+for is the negation of the one it saw on arrival. Waiters pause-spin, then
+yield, then park on std::atomic::wait, so the short waits of a 60-240 Hz
+tick are spent spinning instead of in a condition-variable wakeup, while
+a long wait does not burn a core. As in SafeQueue's SpinThenPark, the
+releasing thread only issues a wake when someone actually parked.
+
+Also defines the configuration and report of ThreadPool::run_lockstep.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <thread>
+#include <vector>
+#include "QueueCommon.h"
+#include "QueueStats.h"
+
+struct BarrierSpin {
+    int spin_count = 2000; // pause-spins before yielding
+    int yield_count = 20;  // yields before parking
+};
+
+class PhaseBarrier {
+private:
+    const size_t m_participants;
+    const BarrierSpin m_spin;
+    const std::function<void()> m_on_phase; // run by the last arrival, before the release
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_remaining;
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> m_sense{false};
+    std::atomic<uint32_t> m_parked{0};
+    std::atomic<uint64_t> m_phase{0};
+
+    void wait_for(bool sense) {
+        for (int i = 0; i < m_spin.spin_count; ++i) {
+            if (m_sense.load(std::memory_order_acquire) == sense) return;
+            cpu_relax();
+        }
+        for (int i = 0; i < m_spin.yield_count; ++i) {
+            if (m_sense.load(std::memory_order_acquire) == sense) return;
+            std::this_thread::yield();
+        }
+        // Registered as parked before the final check, so the releaser either
+        // sees us in m_parked or we see the flipped sense
+        m_parked.fetch_add(1, std::memory_order_seq_cst);
+        while (m_sense.load(std::memory_order_seq_cst) != sense) {
+            m_sense.wait(!sense, std::memory_order_seq_cst);
+        }
+        m_parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+public:
+    /**
+     * @param participants Threads that must arrive to complete a phase.
+     * @param on_phase Optional step run once per phase by the last arrival,
+     * while everyone else is still held; keep it short.
+     */
+    explicit PhaseBarrier(size_t participants, std::function<void()> on_phase = {}, BarrierSpin spin = {})
+        : m_participants(participants), m_spin(spin), m_on_phase(std::move(on_phase)),
+          m_remaining(participants) {}
+
+    PhaseBarrier(const PhaseBarrier&) = delete;
+    PhaseBarrier& operator=(const PhaseBarrier&) = delete;
+
+    /**
+     * @brief Arrives at the barrier and waits for the other participants.
+     * @return True for the one thread whose arrival completed the phase
+     */
+    bool arrive_and_wait() {
+        // The sense cannot flip before we arrive, so we wait for its negation
+        const bool sense = !m_sense.load(std::memory_order_acquire);
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_remaining.store(m_participants, std::memory_order_relaxed);
+            if (m_on_phase) m_on_phase();
+            m_phase.fetch_add(1, std::memory_order_relaxed);
+            m_sense.store(sense, std::memory_order_seq_cst);
+            if (m_parked.load(std::memory_order_seq_cst) > 0) m_sense.notify_all();
+            return true;
+        }
+        wait_for(sense);
+        return false;
+    }
+
+    size_t participants() const { return m_participants; }
+
+    // Phases completed so far
+    uint64_t phase() const { return m_phase.load(std::memory_order_relaxed); }
+};
+
+// --- Lockstep execution (ThreadPool::run_lockstep) ---
+
+struct LockstepConfig {
+    size_t participants = 0;             // threads advancing together; 0 = every task worker + the caller
+    uint64_t ticks = 0;                  // ticks to run
+    std::chrono::nanoseconds period{0};  // tick spacing; 0 runs ticks back to back
+    BarrierSpin spin{};
+    // Called once per tick, at the barrier, with each participant's wait for
+    // that tick; everyone is held while it runs, so keep it short
+    std::function<void(uint64_t tick, std::span<const uint64_t> waits_ns)> on_tick;
+};
+
+struct LockstepStats {
+    size_t participants = 0;
+    uint64_t ticks = 0;
+    std::vector<uint64_t> busy_ns;    // per participant: time in the tick body
+    std::vector<uint64_t> wait_ns;    // per participant: time at the barrier
+    HistogramCounts barrier_wait{};   // one entry per participant per tick
+    HistogramCounts tick_skew{};      // per tick: longest wait, i.e. slowest minus fastest participant
+    uint64_t max_skew_ns = 0;
+
+    // Percentiles are the upper bound of their log2 bucket, capped at the
+    // measured max (the longest wait of any tick is its skew, so max_skew_ns
+    // bounds both)
+    uint64_t wait_percentile_ns(double p) const {
+        return std::min(histogram_percentile_ns(barrier_wait, p), max_skew_ns);
+    }
+    uint64_t skew_percentile_ns(double p) const {
+        return std::min(histogram_percentile_ns(tick_skew, p), max_skew_ns);
+    }
+};
@@ -1,19 +1,68 @@
 /*
 PlayerCommand.h
 Defines the task object for the SafeQueue, representing a single player action.
+
+The action itself is a std::variant of small payload structs, so every
+command kind is stored inline in the queues (no heap allocation, no
+virtual calls) and handlers dispatch on it with std::visit, which the
+compiler resolves to a jump on the variant index.
 */
 
 #pragma once
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+
+// --- Command payloads ---
+
+struct NoAction {};
+
+// Instant upward velocity for the player's bird
+struct Flap {};
+
+// Player enters the game; respawns the bird if the previous run ended
+struct Join {};
+
+// Player leaves; ends the current run
+struct Leave {};
+
+// Pauses or resumes the simulation
+struct Pause {
+    bool paused = true;
+};
+
+enum class AbilityId : uint16_t {
+    Hover // cancel vertical velocity; held for HOVER_TICKS when a TickExecutor is attached
+};
+
+// Triggers one of the player's abilities
+struct Ability {
+    AbilityId id = AbilityId::Hover;
+};
 
-enum class ActionType {
+// Alternative order defines ActionType values below; keep them in sync
+using CommandAction = std::variant<NoAction, Flap, Join, Leave, Pause, Ability>;
+
+enum class ActionType : uint8_t {
+    NONE,
     FLAP,
-    NONE
+    JOIN,
+    LEAVE,
+    PAUSE,
+    ABILITY
+};
+
+// Helper for building a std::visit visitor out of lambdas
+template <typename... Handlers>
+struct Overloaded : Handlers... {
+    using Handlers::operator()...;
 };
 
 struct PlayerCommand {
     int player_id = 0;
-    ActionType type = ActionType::NONE;
+    CommandAction action;
     std::chrono::high_resolution_clock::time_point timestamp;
     
     // Default constructor
@@ -30,4 +79,47 @@ struct PlayerCommand {
     
     // Copy assignment (needed for queue operations)
     PlayerCommand& operator=(const PlayerCommand&) = default;
+
+    // Kind of action, e.g. for keys and routing that don't need the payload
+    ActionType type() const { return static_cast<ActionType>(action.index()); }
+};
+
+static_assert(std::is_same_v<std::variant_alternative_t<static_cast<size_t>(ActionType::ABILITY), CommandAction>, Ability>,
+              "ActionType must follow the CommandAction alternative order");
+
+/**
+ * Coalescing key: while queued, a newer command with the same player and
+ * action supersedes an older one (e.g. repeated FLAPs within one tick).
+ */
+struct PlayerActionKey {
+    uint64_t operator()(const PlayerCommand& command) const {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(command.player_id)) << 32)
+             | static_cast<uint32_t>(command.type());
+    }
+};
+
+// Priority lanes used by LaneQueue (lane 0 is served first)
+enum class CommandLane : size_t {
+    Control = 0,  // session/admin commands: low volume, must not wait behind anything
+    Gameplay = 1, // player input such as FLAP
+    Bulk = 2,     // telemetry and other low-value traffic
+    Count = 3
+};
+
+/**
+ * Maps a command to its priority lane. Session changes (join, leave, pause)
+ * are control traffic, in-game actions are gameplay, anything else is bulk.
+ */
+struct PlayerCommandLane {
+    size_t operator()(const PlayerCommand& command) const {
+        CommandLane lane = std::visit(Overloaded{
+            [](const Flap&) { return CommandLane::Gameplay; },
+            [](const Ability&) { return CommandLane::Gameplay; },
+            [](const Join&) { return CommandLane::Control; },
+            [](const Leave&) { return CommandLane::Control; },
+            [](const Pause&) { return CommandLane::Control; },
+            [](const NoAction&) { return CommandLane::Bulk; }
+        }, command.action);
+        return static_cast<size_t>(lane);
+    }
 };
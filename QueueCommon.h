@@ -0,0 +1,45 @@
+/*
+QueueCommon.h
+Small helpers shared by the queue implementations.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <chrono>
+
+// Assumed cache line size, used to keep producer- and consumer-owned
+// indices on separate lines (avoids false sharing between threads).
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief Hint to the CPU that we are in a spin-wait loop.
+ * Lowers power usage and frees pipeline resources for an SMT sibling.
+ */
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * @brief Rounds a requested capacity up to the next power of two (minimum 2),
+ * so ring indices can be wrapped with a mask instead of a modulo.
+ */
+inline std::size_t round_up_pow2(std::size_t n) {
+    std::size_t cap = 2;
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+// Tag passed to the queues' internal wait helpers for untimed (wait forever) pops
+struct NoDeadline {};
+
+inline bool deadline_passed(NoDeadline) { return false; }
+
+template <typename Clock, typename Duration>
+bool deadline_passed(const std::chrono::time_point<Clock, Duration>& deadline) {
+    return Clock::now() >= deadline;
+}
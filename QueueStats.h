@@ -0,0 +1,165 @@
+/*
+QueueStats.h
+Lightweight queue instrumentation: depth watermarks, push/pop counts and
+log2-bucketed histograms of time-in-queue and lock-acquisition wait.
+
+Recording uses relaxed atomics only, so it is safe from any thread and adds
+no ordering constraints to the queue itself. Readers take a snapshot and
+derive rates and percentiles from it (or from two snapshots).
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Number of items each overflow policy has discarded (or blocked) so far
+struct QueueDropCounters {
+    uint64_t blocked_pushes = 0;
+    uint64_t dropped_newest = 0;
+    uint64_t dropped_oldest = 0;
+    uint64_t dropped_stale = 0;
+};
+
+// Bucket i counts durations in [2^i, 2^(i+1)) ns (bucket 0 also holds 0 ns);
+// 40 buckets reach ~18 minutes, far beyond anything a queue should see.
+constexpr size_t HISTOGRAM_BUCKETS = 40;
+
+using HistogramCounts = std::array<uint64_t, HISTOGRAM_BUCKETS>;
+
+class LatencyHistogram {
+private:
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> m_buckets{};
+
+public:
+    void record(std::chrono::nanoseconds duration) {
+        uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+        size_t bucket = ns == 0 ? 0 : static_cast<size_t>(std::bit_width(ns) - 1);
+        if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    HistogramCounts snapshot() const {
+        HistogramCounts counts{};
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+        return counts;
+    }
+};
+
+/**
+ * @brief Index of the bucket containing the p-th percentile (0 < p <= 1).
+ * @return HISTOGRAM_BUCKETS if the histogram is empty
+ */
+inline size_t histogram_percentile_bucket(const HistogramCounts& counts, double p) {
+    uint64_t total = 0;
+    for (uint64_t c : counts) total += c;
+    if (total == 0) return HISTOGRAM_BUCKETS;
+
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return i;
+    }
+    return HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * @brief Upper bound (in ns) of the bucket containing the p-th percentile (0 < p <= 1).
+ * @return 0 if the histogram is empty
+ */
+inline uint64_t histogram_percentile_ns(const HistogramCounts& counts, double p) {
+    size_t bucket = histogram_percentile_bucket(counts, p);
+    return bucket == HISTOGRAM_BUCKETS ? 0 : uint64_t{1} << (bucket + 1);
+}
+
+/**
+ * @brief Lower bound (in ns) of the bucket containing the p-th percentile:
+ * the percentile is at least this long. Use it to test "over a threshold",
+ * since the upper bound can overstate a value by up to 2x.
+ * @return 0 if the histogram is empty
+ */
+inline uint64_t histogram_percentile_lower_ns(const HistogramCounts& counts, double p) {
+    size_t bucket = histogram_percentile_bucket(counts, p);
+    return bucket == HISTOGRAM_BUCKETS || bucket == 0 ? 0 : uint64_t{1} << bucket;
+}
+
+struct QueueStatsSnapshot {
+    std::chrono::steady_clock::time_point taken_at;
+    size_t depth = 0;
+    size_t peak_depth = 0;
+    uint64_t pushes = 0;
+    uint64_t pops = 0;
+    uint64_t uncontended_locks = 0;   // lock acquired on the first try
+    HistogramCounts queue_wait{};     // enqueue -> dequeue time per item
+    HistogramCounts lock_wait{};      // wait for m_mutex, contended acquisitions only
+    QueueDropCounters drops;
+};
+
+struct QueueRates {
+    double pushes_per_sec = 0.0;
+    double pops_per_sec = 0.0;
+};
+
+/**
+ * @brief Push/pop rates between two snapshots of the same queue.
+ */
+inline QueueRates queue_rates(const QueueStatsSnapshot& before, const QueueStatsSnapshot& after) {
+    double seconds = std::chrono::duration<double>(after.taken_at - before.taken_at).count();
+    if (seconds <= 0.0) return {};
+    return QueueRates{
+        static_cast<double>(after.pushes - before.pushes) / seconds,
+        static_cast<double>(after.pops - before.pops) / seconds
+    };
+}
+
+/**
+ * The live counters a queue records into. Depth and peak are written by
+ * the owning queue under its own lock; everything else may be recorded
+ * from any thread.
+ */
+class QueueStats {
+private:
+    std::atomic<size_t> m_depth{0};
+    std::atomic<size_t> m_peak_depth{0};
+    std::atomic<uint64_t> m_pushes{0};
+    std::atomic<uint64_t> m_pops{0};
+    std::atomic<uint64_t> m_uncontended_locks{0};
+    LatencyHistogram m_queue_wait;
+    LatencyHistogram m_lock_wait;
+
+public:
+    // Caller must serialise depth updates (the queue's mutex does)
+    void set_depth(size_t depth) {
+        m_depth.store(depth, std::memory_order_relaxed);
+        if (depth > m_peak_depth.load(std::memory_order_relaxed)) {
+            m_peak_depth.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    void record_push() { m_pushes.fetch_add(1, std::memory_order_relaxed); }
+    void record_pops(uint64_t count) { m_pops.fetch_add(count, std::memory_order_relaxed); }
+    void record_queue_wait(std::chrono::nanoseconds wait) { m_queue_wait.record(wait); }
+    void record_uncontended_lock() { m_uncontended_locks.fetch_add(1, std::memory_order_relaxed); }
+    void record_lock_wait(std::chrono::nanoseconds wait) { m_lock_wait.record(wait); }
+
+    QueueStatsSnapshot snapshot() const {
+        QueueStatsSnapshot s;
+        s.taken_at = std::chrono::steady_clock::now();
+        s.depth = m_depth.load(std::memory_order_relaxed);
+        s.peak_depth = m_peak_depth.load(std::memory_order_relaxed);
+        s.pushes = m_pushes.load(std::memory_order_relaxed);
+        s.pops = m_pops.load(std::memory_order_relaxed);
+        s.uncontended_locks = m_uncontended_locks.load(std::memory_order_relaxed);
+        s.queue_wait = m_queue_wait.snapshot();
+        s.lock_wait = m_lock_wait.snapshot();
+        return s;
+    }
+};
@@ -0,0 +1,278 @@
+/*
+RingQueue.h
+Bounded, lock-free multi-producer/multi-consumer ring buffer.
+
+Drop-in alternative to SafeQueue with the same push/pop/stop contract.
+Each slot carries a sequence number (Vyukov's bounded MPMC design), so
+producers and consumers only contend on a single CAS of their own index
+instead of a shared mutex. Consumers that find the ring empty spin briefly
+and then park; producers only touch the park mutex when someone is parked.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include "QueueCommon.h"
+
+template <typename T>
+class RingQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static constexpr int SPIN_LIMIT = 64; // pause-spins before parking a consumer
+    // Set in m_enqueue_pos by stop(), so no slot can be claimed afterwards
+    static constexpr size_t STOPPED_BIT = size_t{1} << (sizeof(size_t) * 8 - 1);
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    // Producer and consumer cursors live on separate cache lines
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueue_pos{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_dequeue_pos{0};
+
+    // Parking support for consumers that find the ring empty
+    alignas(CACHE_LINE_SIZE) std::atomic<int> m_sleepers{0};
+    std::atomic<bool> m_stop{false};
+    std::mutex m_park_mutex;
+    std::condition_variable m_park_cv;
+
+    /**
+     * @brief Attempts to claim a free slot and move the item into it.
+     * The item is only moved from when the call succeeds.
+     * @return False if the ring is full or stopped
+     */
+    bool try_enqueue(T& item) {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            if (pos & STOPPED_BIT) return false; // stop() froze the claimed range
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false; // slot still holds an unconsumed item: ring is full
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Attempts to take the oldest published item.
+     * @return False if the ring is empty
+     */
+    bool try_dequeue(T& item) {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false; // slot not yet published: ring is empty
+            } else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        // Mark the slot free for the producer one lap ahead
+        cell->sequence.store(pos + m_capacity, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Dequeue once the queue is stopped. An empty head is not enough
+     * to report empty: a producer may have claimed the next position but not
+     * published it yet, and its push() will still return true. stop() froze
+     * the claimed range, so wait for every position in it to be published
+     * and taken before giving up.
+     */
+    bool drain_after_stop(T& item) {
+        const size_t claimed = m_enqueue_pos.load(std::memory_order_acquire) & ~STOPPED_BIT;
+        for (;;) {
+            if (try_dequeue(item)) return true;
+            if (m_dequeue_pos.load(std::memory_order_acquire) >= claimed) return false;
+            std::this_thread::yield(); // a producer is between claiming and publishing
+        }
+    }
+
+    /**
+     * @brief Dequeues, spinning briefly and then parking until an item
+     * arrives, the queue is stopped or the deadline passes.
+     */
+    template <typename Deadline>
+    bool wait_and_dequeue(T& item, const Deadline& deadline) {
+        constexpr bool timed = !std::is_same_v<Deadline, NoDeadline>;
+
+        // Fast path: short spin, most pops under load never park
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (try_dequeue(item)) return true;
+            if (m_stop.load(std::memory_order_acquire)) return drain_after_stop(item);
+            cpu_relax();
+        }
+
+        // Slow path: register as a sleeper, then re-check before waiting
+        std::unique_lock<std::mutex> lock(m_park_mutex);
+        m_sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got = false;
+        for (;;) {
+            if (try_dequeue(item)) { got = true; break; }
+            if (m_stop.load(std::memory_order_acquire)) { got = drain_after_stop(item); break; }
+            if constexpr (timed) {
+                if (m_park_cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+                    got = try_dequeue(item);
+                    break;
+                }
+            } else {
+                m_park_cv.wait(lock);
+            }
+        }
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return got;
+    }
+
+    // Wake one parked consumer, but only pay for the mutex when one exists
+    void wake_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m_park_mutex);
+            m_park_cv.notify_one();
+        }
+    }
+
+public:
+    /**
+     * @brief Constructs the ring.
+     * @param capacity Requested number of slots, rounded up to a power of two.
+     */
+    explicit RingQueue(size_t capacity = 1024)
+        : m_capacity(round_up_pow2(capacity)),
+          m_mask(m_capacity - 1),
+          m_cells(new Cell[m_capacity])
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    /**
+     * @brief Push an item. Waits for a free slot if the ring is full.
+     * Items pushed after stop() are discarded, as with SafeQueue.
+     * @return True if the item was enqueued, false if the queue is stopped
+     */
+    bool push(T item) {
+        if (m_stop.load(std::memory_order_acquire)) return false;
+        while (!try_enqueue(item)) {
+            if (m_stop.load(std::memory_order_relaxed)) return false;
+            std::this_thread::yield(); // consumers are behind; let them run
+        }
+        wake_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop an item from the queue
+     * @param item Reference to store the popped value
+     * @return True if an item was popped, false if the queue is stopped and empty
+     */
+    bool pop(T& item) {
+        return wait_and_dequeue(item, NoDeadline{});
+    }
+
+    /**
+     * @brief Pop an item without waiting
+     * @return True if an item was popped, false if the ring was empty
+     */
+    bool try_pop(T& item) {
+        return try_dequeue(item);
+    }
+
+    /**
+     * @brief Pop an item, waiting at most until the deadline
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_and_dequeue(item, deadline);
+    }
+
+    /**
+     * @brief Pop an item, waiting at most for the given duration
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Pop up to max items into a caller-provided buffer
+     * Blocks until at least one item is available or the queue is stopped.
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0 || !pop(out[0])) return 0;
+        size_t count = 1;
+        while (count < max && try_dequeue(out[count])) ++count;
+        return count;
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0 || !pop_until(out[0], deadline)) return 0;
+        size_t count = 1;
+        while (count < max && try_dequeue(out[count])) ++count;
+        return count;
+    }
+
+    /**
+     * signals queue to stop, wakes up all waiting threads
+     * remaining items can still be popped until the ring is empty
+    */
+    void stop() {
+        m_enqueue_pos.fetch_or(STOPPED_BIT, std::memory_order_acq_rel);
+        m_stop.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(m_park_mutex);
+        m_park_cv.notify_all();
+    }
+
+    /**
+     * @brief True once stop() has been called (items may still be queued)
+     */
+    bool stopped() const {
+        return m_stop.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return m_capacity; }
+};
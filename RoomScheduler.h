@@ -0,0 +1,327 @@
+/*
+RoomScheduler.h
+Ticks many independent game worlds ("rooms") on the ThreadPool.
+
+Each room has its own tick period and next deadline. Deadlines live in a
+hierarchical TimingWheel, so adding, removing or re-arming a room is O(1)
+no matter how many rooms exist. One driver thread advances the wheel
+every `resolution`, collects the rooms that are due and posts them to the
+pool in batches; a room is re-armed for its next deadline only after its
+tick has run, so a room never ticks on two workers at once. No room has a
+thread or a sleep loop of its own.
+
+A room that falls more than `max_catch_up` periods behind skips the
+missed ticks instead of running them back to back; skipped ticks are
+counted. Lateness (start of a tick minus its deadline) goes into a
+histogram, read with stats().
+
+Lockstep mode (run_lockstep) is the alternative for rooms that must stay
+in sync, such as a tournament: instead of the wheel, the rooms are split
+across the participants of ThreadPool::run_lockstep and no room starts
+tick N+1 before every room has finished tick N.
+
+World is any type with update_physics(float dt), e.g. GameState.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+#include "TimingWheel.h"
+#include "QueueStats.h"
+
+using RoomId = uint32_t;
+
+struct RoomSchedulerConfig {
+    std::chrono::microseconds resolution{1000};       // wheel tick
+    size_t batch_size = 64;                           // rooms per pool task
+    uint32_t max_catch_up = 4;                        // periods behind before ticks are skipped
+    std::chrono::microseconds late_threshold{2000};   // lateness counted as "late"
+};
+
+struct RoomSchedulerStats {
+    size_t rooms = 0;
+    uint64_t ticks = 0;          // room ticks run
+    uint64_t late_ticks = 0;     // started more than late_threshold after their deadline
+    uint64_t skipped_ticks = 0;  // dropped to catch up
+    uint64_t batches = 0;        // pool tasks posted
+    uint64_t max_lateness_ns = 0;
+    HistogramCounts lateness{};  // per tick: start - deadline
+
+    // Upper bound of the percentile's log2 bucket, capped at the measured maximum
+    uint64_t lateness_percentile_ns(double p) const {
+        return std::min(histogram_percentile_ns(lateness, p), max_lateness_ns);
+    }
+};
+
+template <typename World>
+class RoomScheduler {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // The wheel hands back the WheelTimer base of each due room
+    struct Room : WheelTimer {
+        RoomId id = 0;
+        std::unique_ptr<World> world;
+        Clock::duration period{};
+        float dt = 0.0f;
+        Clock::time_point deadline;
+        bool running = false; // dispatched, not yet re-armed
+        bool removed = false;
+        Room* next_in_batch = nullptr; // links a dispatched batch; owned by it while running
+    };
+
+    ThreadPool& m_pool;
+    const RoomSchedulerConfig m_config;
+    const Clock::time_point m_epoch; // wheel tick 0
+
+    // Guards the wheel and room bookkeeping; rooms' worlds are ticked unlocked
+    mutable std::mutex m_mutex;
+    TimingWheel m_wheel;
+    std::vector<std::unique_ptr<Room>> m_rooms; // indexed by RoomId; stable addresses
+    size_t m_live_rooms = 0;
+
+    std::thread m_driver;
+    std::condition_variable m_cv;      // wakes the driver for stop()
+    std::condition_variable m_idle_cv; // a room finished its tick after stop()
+    bool m_stop = false;
+
+    LatencyHistogram m_lateness;
+    std::atomic<uint64_t> m_ticks{0};
+    std::atomic<uint64_t> m_late_ticks{0};
+    std::atomic<uint64_t> m_skipped_ticks{0};
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_max_lateness_ns{0};
+
+    // First wheel tick at or after `time`
+    uint64_t tick_at(Clock::time_point time) const {
+        auto since = std::max(Clock::duration::zero(), time - m_epoch);
+        auto resolution = std::chrono::duration_cast<Clock::duration>(m_config.resolution);
+        return static_cast<uint64_t>((since + resolution - Clock::duration(1)) / resolution);
+    }
+
+    // Last wheel tick that has fully passed at `time`
+    uint64_t tick_before(Clock::time_point time) const {
+        auto since = std::max(Clock::duration::zero(), time - m_epoch);
+        return static_cast<uint64_t>(since / std::chrono::duration_cast<Clock::duration>(m_config.resolution));
+    }
+
+    void run_room(Room& room) {
+        auto start = Clock::now();
+        auto lateness = std::chrono::duration_cast<std::chrono::nanoseconds>(start - room.deadline);
+        m_lateness.record(lateness);
+        if (lateness > m_config.late_threshold) m_late_ticks.fetch_add(1, std::memory_order_relaxed);
+        uint64_t late_ns = lateness.count() > 0 ? static_cast<uint64_t>(lateness.count()) : 0;
+        uint64_t worst = m_max_lateness_ns.load(std::memory_order_relaxed);
+        while (late_ns > worst && !m_max_lateness_ns.compare_exchange_weak(worst, late_ns, std::memory_order_relaxed)) {}
+
+        try {
+            room.world->update_physics(room.dt);
+        } catch (const std::exception& e) {
+            std::cerr << "[RoomScheduler] Warning: room " << room.id << " tick threw: " << e.what() << std::endl;
+        }
+        m_ticks.fetch_add(1, std::memory_order_relaxed);
+
+        // Next deadline keeps the room's cadence; far behind, skip to the present
+        room.deadline += room.period;
+        auto behind = Clock::now() - room.deadline;
+        if (behind > room.period * m_config.max_catch_up) {
+            auto skipped = behind / room.period;
+            room.deadline += room.period * skipped;
+            m_skipped_ticks.fetch_add(static_cast<uint64_t>(skipped), std::memory_order_relaxed);
+        }
+
+        std::unique_ptr<World> retired;
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            room.running = false;
+            if (room.removed) {
+                retired = std::move(room.world); // destroyed outside the lock
+            } else {
+                m_wheel.schedule(room, tick_at(room.deadline));
+            }
+            stopping = m_stop;
+        }
+        if (stopping) m_idle_cv.notify_all();
+    }
+
+    // Posts `due` in batches. Each batch is a list linked through the rooms
+    // themselves, so the task captures one pointer and nothing is allocated.
+    void dispatch(std::vector<Room*>& due) {
+        for (size_t first = 0; first < due.size(); first += m_config.batch_size) {
+            size_t last = std::min(due.size(), first + m_config.batch_size);
+            for (size_t i = first; i < last; ++i) due[i]->next_in_batch = i + 1 < last ? due[i + 1] : nullptr;
+            m_batches.fetch_add(1, std::memory_order_relaxed);
+            m_pool.post([this, head = due[first]] {
+                for (Room* room = head; room;) {
+                    // Read before the tick: once re-armed, the room may join another batch
+                    Room* next = room->next_in_batch;
+                    run_room(*room);
+                    room = next;
+                }
+            });
+        }
+        due.clear();
+    }
+
+    void driver_loop() {
+        std::vector<Room*> due;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop) {
+            m_wheel.advance(tick_before(Clock::now()), [&due](WheelTimer& timer) {
+                Room* room = static_cast<Room*>(&timer);
+                room->running = true;
+                due.push_back(room);
+            });
+            if (!due.empty()) {
+                lock.unlock();
+                dispatch(due);
+                lock.lock();
+                continue; // time may have moved on while dispatching
+            }
+            auto next = m_epoch + std::chrono::duration_cast<Clock::duration>(m_config.resolution) * (m_wheel.now() + 1);
+            m_cv.wait_until(lock, next, [this] { return m_stop; });
+        }
+    }
+
+public:
+    explicit RoomScheduler(ThreadPool& pool, RoomSchedulerConfig config = {})
+        : m_pool(pool), m_config(config), m_epoch(Clock::now()) {}
+
+    RoomScheduler(const RoomScheduler&) = delete;
+    RoomScheduler& operator=(const RoomScheduler&) = delete;
+
+    ~RoomScheduler() { stop(); }
+
+    /**
+     * @brief Adds a room ticking every `period`, first due one period from now.
+     * Safe to call while the scheduler is running.
+     */
+    RoomId add_room(std::unique_ptr<World> world, std::chrono::nanoseconds period) {
+        auto room = std::make_unique<Room>();
+        room->world = std::move(world);
+        room->period = std::chrono::duration_cast<Clock::duration>(period);
+        room->dt = std::chrono::duration<float>(period).count();
+        room->deadline = Clock::now() + room->period;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        room->id = static_cast<RoomId>(m_rooms.size());
+        m_wheel.schedule(*room, tick_at(room->deadline));
+        m_rooms.push_back(std::move(room));
+        ++m_live_rooms;
+        return m_rooms.back()->id;
+    }
+
+    /**
+     * @brief Stops ticking a room and destroys its world. If the room is
+     * ticking right now, its world is destroyed once that tick finishes.
+     */
+    void remove_room(RoomId id) {
+        std::unique_ptr<World> retired;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (id >= m_rooms.size() || m_rooms[id]->removed) return;
+            Room& room = *m_rooms[id];
+            room.removed = true;
+            --m_live_rooms;
+            m_wheel.cancel(room);
+            if (!room.running) retired = std::move(room.world);
+        }
+    }
+
+    /**
+     * @brief The room's world. Only touch it when the room cannot be ticking
+     * (before start(), after stop(), or under the world's own lock).
+     */
+    World* world(RoomId id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return id < m_rooms.size() ? m_rooms[id]->world.get() : nullptr;
+    }
+
+    // Starts the driver thread
+    void start() {
+        m_driver = std::thread(&RoomScheduler::driver_loop, this);
+    }
+
+    /**
+     * @brief Stops the driver and waits for dispatched ticks to finish.
+     */
+    void stop() {
+        if (!m_driver.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_driver.join();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle_cv.wait(lock, [this] {
+            return std::none_of(m_rooms.begin(), m_rooms.end(), [](const auto& room) { return room->running; });
+        });
+    }
+
+    /**
+     * @brief Ticks every live room config.ticks times in lockstep, rooms split
+     * into contiguous groups, one per participant (0, or more than the pool
+     * can run, = ThreadPool::max_lockstep_participants()).
+     * Each tick advances a room by its own period. Blocks until done; only
+     * valid while the driver is not running (before start() or after stop()).
+     * @return Per-participant busy and barrier-wait time, and per-tick skew
+     */
+    LockstepStats run_lockstep(LockstepConfig config) {
+        std::vector<Room*> rooms;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_driver.joinable()) {
+                std::cerr << "[RoomScheduler] Warning: run_lockstep while the driver is running; call stop() first" << std::endl;
+                return LockstepStats{};
+            }
+            for (auto& room : m_rooms) {
+                if (!room->removed) rooms.push_back(room.get());
+            }
+        }
+        const size_t capacity = m_pool.max_lockstep_participants();
+        if (config.participants == 0 || config.participants > capacity) config.participants = capacity;
+        config.participants = std::max<size_t>(1, std::min(config.participants, rooms.size()));
+
+        const size_t groups = config.participants;
+        return m_pool.run_lockstep(std::move(config), [this, &rooms, groups](size_t participant, uint64_t) {
+            size_t first = rooms.size() * participant / groups;
+            size_t last = rooms.size() * (participant + 1) / groups;
+            for (size_t i = first; i < last; ++i) {
+                try {
+                    rooms[i]->world->update_physics(rooms[i]->dt);
+                } catch (const std::exception& e) {
+                    std::cerr << "[RoomScheduler] Warning: room " << rooms[i]->id << " tick threw: " << e.what() << std::endl;
+                }
+            }
+            m_ticks.fetch_add(last - first, std::memory_order_relaxed);
+        });
+    }
+
+    RoomSchedulerStats stats() const {
+        RoomSchedulerStats stats;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            stats.rooms = m_live_rooms;
+        }
+        stats.ticks = m_ticks.load(std::memory_order_relaxed);
+        stats.late_ticks = m_late_ticks.load(std::memory_order_relaxed);
+        stats.skipped_ticks = m_skipped_ticks.load(std::memory_order_relaxed);
+        stats.batches = m_batches.load(std::memory_order_relaxed);
+        stats.max_lateness_ns = m_max_lateness_ns.load(std::memory_order_relaxed);
+        stats.lateness = m_lateness.snapshot();
+        return stats;
+    }
+};
@@ -1,29 +1,332 @@
-/* The generic, thread-safe bounded buffer that decouples the 
+/* The generic, thread-safe bounded buffer that decouples the
 I/O thread (Producer) from the CPU worker threads (Consumers).
 */
 
-#pragma once 
+#pragma once
 
 #include <queue>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <thread>
 #include <mutex>
 #include <condition_variable>
+#include "QueueCommon.h"
+#include "QueueStats.h"
+
+/**
+ * What push() does when a bounded queue is full.
+ */
+enum class OverflowPolicy {
+    Block,      // producer waits until a consumer frees a slot
+    DropNewest, // the incoming item is discarded
+    DropOldest, // the item at the front is discarded to make room
+    DropStale   // items older than QueueConfig::max_age are discarded (front first, and on pop)
+};
+
+/**
+ * How a consumer waits on an empty queue.
+ * SpinThenPark only pays off when the producer runs on another core and items
+ * usually arrive within QueueConfig::spin_for: the consumer then skips the
+ * sleep/wake round trip. On a single hardware thread the spin would only
+ * delay the producer, so the queue parks straight away and behaves like Block.
+ */
+enum class WaitStrategy {
+    Block,       // sleep on the condition variable straight away (lowest CPU use)
+    SpinThenPark // busy-spin with a CPU pause, then yield, then park on an atomic wait
+};
+
+struct QueueConfig {
+    size_t capacity = 0;                         // 0 = unbounded
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    std::chrono::microseconds max_age{0};        // staleness deadline for DropStale
+    WaitStrategy wait = WaitStrategy::Block;
+    int spin_count = 2000;                       // SpinThenPark: pause-spins before yielding
+    int yield_count = 20;                        // SpinThenPark: yields before parking
+    std::chrono::microseconds spin_for{20};      // SpinThenPark: time spinning and yielding before parking
+    bool instrument = false;                     // record QueueStats (depth, rates, wait histograms);
+                                                 // off, stats() only reports the drop counters
+};
+
+// Items with a clock timestamp (e.g. PlayerCommand) can be aged for DropStale
+template <typename T>
+concept TimestampedItem = requires (const T& item) { item.timestamp.time_since_epoch(); };
 
 template <typename T>
 
 class SafeQueue {
 private:
-    std::queue<T> m_queue;
+    // Items carry their enqueue time so time spent in the queue can be measured
+    struct Entry {
+        T item;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    std::queue<Entry> m_queue;
     std::mutex m_mutex;
     std::condition_variable m_condition;
-    bool m_stop = false;
+    std::condition_variable m_not_full; // producers blocked by OverflowPolicy::Block
+    std::atomic<bool> m_stop{false};
+    const QueueConfig m_config;
+    // Spinning needs another hardware thread to make progress meanwhile
+    const bool m_can_spin = std::thread::hardware_concurrency() > 1;
+
+    // Lock-free view of the queue used by spinning consumers. Stores are
+    // made under m_mutex; together with m_epoch/m_parked they form an
+    // event count so producers only issue a wake when someone is parked.
+    std::atomic<size_t> m_size{0};
+    std::atomic<uint32_t> m_epoch{0};
+    std::atomic<uint32_t> m_parked{0};
+    int m_cv_waiters = 0; // consumers sleeping on m_condition (guarded by m_mutex)
+
+    std::atomic<uint64_t> m_blocked_pushes{0};
+    std::atomic<uint64_t> m_dropped_newest{0};
+    std::atomic<uint64_t> m_dropped_oldest{0};
+    std::atomic<uint64_t> m_dropped_stale{0};
+    QueueStats m_stats;
+
+    // Told about every accepted item the queue discards itself (see set_discard_handler)
+    std::function<void(const T&)> m_on_discard;
+
+    bool bounded() const { return m_config.capacity > 0; }
+    bool full() const { return bounded() && m_queue.size() >= m_config.capacity; }
+
+    bool is_stale(const T& item) const {
+        if constexpr (TimestampedItem<T>) {
+            using Clock = typename decltype(item.timestamp)::clock;
+            return Clock::now() - item.timestamp > m_config.max_age;
+        } else {
+            return false; // no timestamp to age by
+        }
+    }
+
+    // Drops the front item after reporting it to the discard handler; caller must hold m_mutex
+    void discard_front() {
+        if (m_on_discard) m_on_discard(m_queue.front().item);
+        m_queue.pop();
+    }
+
+    // Discards stale items from the front; caller must hold m_mutex
+    void discard_stale() {
+        uint64_t dropped = 0;
+        while (!m_queue.empty() && is_stale(m_queue.front().item)) {
+            discard_front();
+            ++dropped;
+        }
+        if (dropped > 0) {
+            m_dropped_stale.fetch_add(dropped, std::memory_order_relaxed);
+            publish_size();
+        }
+    }
+
+    /**
+     * @brief Waits until there is something to pop, the queue is stopped or
+     * the deadline passes (NoDeadline waits forever).
+     * @return True if items are available, false if stopped and empty or timed out
+     */
+    template <typename Deadline>
+    bool wait_for_items(std::unique_lock<std::mutex>& lock, const Deadline& deadline) {
+        constexpr bool timed = !std::is_same_v<Deadline, NoDeadline>;
+        auto ready = [this] { return m_stop || !m_queue.empty(); };
+        for (;;) {
+            if (m_config.overflow == OverflowPolicy::DropStale) discard_stale();
+            if (!m_queue.empty()) return true;
+            if (m_stop || deadline_passed(deadline)) return false;
+
+            // One hardware thread: sleep on m_condition as Block does, since
+            // even atomic::wait spins and yields before it sleeps
+            if (m_config.wait == WaitStrategy::SpinThenPark && m_can_spin) {
+                lock.unlock();
+                bool seen = spin_until_ready(deadline);
+                // atomic::wait cannot time out, so timed waits park on m_condition instead
+                if (!seen && !timed) park();
+                lock.lock();
+                if (seen || !timed) continue;
+            }
+
+            ++m_cv_waiters;
+            if constexpr (timed) {
+                m_condition.wait_until(lock, deadline, ready);
+            } else {
+                m_condition.wait(lock, ready);
+            }
+            --m_cv_waiters;
+        }
+    }
+
+    /**
+     * @brief Pause-spins, then yields, without holding m_mutex until the queue
+     * looks non-empty or is stopped. Gives up after QueueConfig::spin_for, or
+     * early if the deadline passes.
+     * The caller re-checks under the lock, so a lost race just loops.
+     * @return True if an item (or stop) was observed
+     */
+    template <typename Deadline>
+    bool spin_until_ready(const Deadline& deadline) {
+        auto ready = [this] {
+            return m_size.load(std::memory_order_acquire) > 0 || m_stop.load(std::memory_order_acquire);
+        };
+        const auto give_up = std::chrono::steady_clock::now() + m_config.spin_for;
+        auto out_of_time = [&] { return deadline_passed(give_up) || deadline_passed(deadline); };
+        for (int i = 0; i < m_config.spin_count; ++i) {
+            if (ready()) return true;
+            if ((i & 63) == 63 && out_of_time()) return false;
+            cpu_relax();
+        }
+        for (int i = 0; i < m_config.yield_count; ++i) {
+            if (ready()) return true;
+            if (out_of_time()) return false;
+            std::this_thread::yield();
+        }
+        return ready();
+    }
+
+    /**
+     * @brief Sleeps on m_epoch (std::atomic::wait) until a producer or stop()
+     * bumps it. Registers as parked before the final check so a concurrent
+     * push either sees us in m_parked or we see its item in m_size.
+     */
+    void park() {
+        m_parked.fetch_add(1, std::memory_order_seq_cst);
+        const uint32_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        if (m_size.load(std::memory_order_seq_cst) == 0 && !m_stop.load(std::memory_order_seq_cst)) {
+            m_epoch.wait(epoch, std::memory_order_seq_cst);
+        }
+        m_parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Locks m_mutex, recording how long the acquisition waited.
+     * The uncontended case is a single try_lock with no clock reads.
+     */
+    std::unique_lock<std::mutex> acquire() {
+        if (!m_config.instrument) return std::unique_lock<std::mutex>(m_mutex);
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            m_stats.record_uncontended_lock();
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            m_stats.record_lock_wait(std::chrono::steady_clock::now() - start);
+        }
+        return lock;
+    }
+
+    std::chrono::steady_clock::time_point stamp() const {
+        return m_config.instrument ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    }
+
+    // Moves the front item out and records its time in queue; caller must hold m_mutex
+    void take_front(T& item, std::chrono::steady_clock::time_point now) {
+        Entry& entry = m_queue.front();
+        if (m_config.instrument) m_stats.record_queue_wait(now - entry.enqueued);
+        item = std::move(entry.item);
+        m_queue.pop();
+    }
+
+    // Pops one item after a successful wait; caller must hold m_mutex
+    void take_one(T& item) {
+        take_front(item, stamp());
+        publish_size();
+        if (m_config.instrument) m_stats.record_pops(1);
+        notify_not_full(1);
+    }
+
+    // Moves up to max items from the front into out; caller must hold m_mutex
+    size_t take_bulk(std::span<T> out, size_t max) {
+        const auto now = stamp();
+        size_t count = 0;
+        while (count < max && !m_queue.empty()) {
+            take_front(out[count++], now);
+        }
+        publish_size();
+        if (m_config.instrument) m_stats.record_pops(count);
+        notify_not_full(count);
+        return count;
+    }
+
+    // Publishes the new depth for spinning consumers and stats; caller must hold m_mutex
+    void publish_size() {
+        m_size.store(m_queue.size(), std::memory_order_seq_cst);
+        if (m_config.instrument) m_stats.set_depth(m_queue.size());
+    }
+
+    // Wakes a consumer after a push, skipping the wake call if none is waiting.
+    // Caller must hold m_mutex.
+    void notify_item_available() {
+        if (m_cv_waiters > 0) m_condition.notify_one();
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (m_parked.load(std::memory_order_seq_cst) > 0) m_epoch.notify_one();
+    }
+
+    // Wakes producers blocked on a full queue after `freed` slots became available
+    void notify_not_full(size_t freed) {
+        if (!bounded() || m_config.overflow != OverflowPolicy::Block) return;
+        if (freed == 1) m_not_full.notify_one();
+        else m_not_full.notify_all();
+    }
 
 public:
-    void push(T item) {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (m_stop) return;
+    SafeQueue() = default;
+
+    /**
+     * @brief Constructs a queue with a capacity limit and overflow policy.
+     */
+    explicit SafeQueue(QueueConfig config) : m_config(config) {}
 
-        m_queue.push(std::move(item));
-        m_condition.notify_one();
+    /**
+     * @brief Sets a callback for items the queue discards after accepting them:
+     * DropOldest evictions and DropStale expiries. Pushes that return false
+     * are not reported. It runs under the queue lock, so keep it short and do
+     * not touch the queue from it; set it before the queue is shared.
+     */
+    void set_discard_handler(std::function<void(const T&)> handler) {
+        m_on_discard = std::move(handler);
+    }
+
+    /**
+     * @brief Push an item, applying the overflow policy if the queue is full
+     * @return True if the item was enqueued, false if it was dropped or the queue is stopped
+     */
+    bool push(T item) {
+        auto lock = acquire();
+        if (m_stop) return false;
+
+        if (full()) {
+            switch (m_config.overflow) {
+            case OverflowPolicy::Block:
+                m_blocked_pushes.fetch_add(1, std::memory_order_relaxed);
+                m_not_full.wait(lock, [this] { return m_stop || !full(); });
+                if (m_stop) return false;
+                break;
+            case OverflowPolicy::DropNewest:
+                m_dropped_newest.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            case OverflowPolicy::DropOldest:
+                discard_front();
+                m_dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case OverflowPolicy::DropStale:
+                discard_stale();
+                if (full()) {
+                    // Nothing old enough to shed: keep the queued items, drop this one
+                    m_dropped_newest.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                break;
+            }
+        }
+
+        m_queue.push(Entry{std::move(item), stamp()});
+        publish_size();
+        if (m_config.instrument) m_stats.record_push();
+        notify_item_available();
+        return true;
     }
     /**
      * @brief Pop an item from the queue
@@ -31,19 +334,105 @@ public:
      * @return True if an item was popped, false if the queue is stopped and empty
      */
     bool pop(T& item) {
-        std::unique_lock<std::mutex> lock(m_mutex);
+        auto lock = acquire();
 
         //wait for queue to be non-empty or stop request
-        m_condition.wait(lock, [this] 
-            { return m_stop || !m_queue.empty(); }
-        );
-
-        if (m_stop && m_queue.empty()) return false;
+        if (!wait_for_items(lock, NoDeadline{})) return false;
 
         // store popped element in the reference parameter
-        item = std::move(m_queue.front());
-        m_queue.pop();
-        return true; 
+        take_one(item);
+        return true;
+    }
+
+    /**
+     * @brief Pop up to max items into a caller-provided buffer under a single lock
+     * Blocks until at least one item is available or the queue is stopped.
+     * @param out Buffer to move the popped items into
+     * @param max Upper bound on items popped (also bounded by out.size())
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+
+        auto lock = acquire();
+        if (!wait_for_items(lock, NoDeadline{})) return 0;
+        return take_bulk(out, max);
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0) return 0;
+
+        auto lock = acquire();
+        if (!wait_for_items(lock, deadline)) return 0;
+        return take_bulk(out, max);
+    }
+
+    /**
+     * @brief Pop an item without waiting
+     * @return True if an item was popped, false if the queue was empty
+     */
+    bool try_pop(T& item) {
+        auto lock = acquire();
+        if (m_config.overflow == OverflowPolicy::DropStale) discard_stale();
+        if (m_queue.empty()) return false;
+        take_one(item);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most until the deadline
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        auto lock = acquire();
+        if (!wait_for_items(lock, deadline)) return false;
+        take_one(item);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most for the given duration
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Take every queued item at once by swapping out the backing queue
+     * Blocks until at least one item is available or the queue is stopped.
+     * Items are appended to out after the lock has been released.
+     * @return True if items were drained, false if the queue is stopped and empty
+     */
+    bool drain_into(std::vector<T>& out) {
+        std::queue<Entry> drained;
+        std::chrono::steady_clock::time_point now;
+        {
+            auto lock = acquire();
+            if (!wait_for_items(lock, NoDeadline{})) return false;
+            std::swap(drained, m_queue);
+            now = stamp();
+            publish_size();
+            if (m_config.instrument) m_stats.record_pops(drained.size());
+            notify_not_full(drained.size());
+        }
+
+        out.reserve(out.size() + drained.size());
+        while (!drained.empty()) {
+            if (m_config.instrument) m_stats.record_queue_wait(now - drained.front().enqueued);
+            out.push_back(std::move(drained.front().item));
+            drained.pop();
+        }
+        return true;
     }
 
     /**
@@ -54,5 +443,39 @@ public:
         std::unique_lock<std::mutex> lock(m_mutex);
         m_stop = true;
         m_condition.notify_all();
+        m_not_full.notify_all();
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        m_epoch.notify_all();
+    }
+
+    /**
+     * @brief True once stop() has been called (items may still be queued)
+     */
+    bool stopped() const {
+        return m_stop.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Per-policy drop counters (relaxed reads, safe from any thread)
+     */
+    QueueDropCounters drop_counters() const {
+        return QueueDropCounters{
+            m_blocked_pushes.load(std::memory_order_relaxed),
+            m_dropped_newest.load(std::memory_order_relaxed),
+            m_dropped_oldest.load(std::memory_order_relaxed),
+            m_dropped_stale.load(std::memory_order_relaxed)
+        };
+    }
+
+    /**
+     * @brief Snapshot of depth, peak depth, push/pop counts, drop counters and
+     * the time-in-queue and lock-wait histograms (relaxed reads, any thread).
+     * Rates come from two snapshots via queue_rates(). Everything but the drop
+     * counters needs QueueConfig::instrument.
+     */
+    QueueStatsSnapshot stats() const {
+        QueueStatsSnapshot snapshot = m_stats.snapshot();
+        snapshot.drops = drop_counters();
+        return snapshot;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,342 @@
+/*
+ShardedDispatcher.h
+Routes each player's commands to a single worker-owned CommandQueue.
+
+Players are hashed into a fixed set of buckets and every bucket is owned
+by exactly one shard (worker) at a time, so two commands from the same
+player are always applied in order, and workers no longer fight over one
+shared queue. Idle workers can take over buckets from a busier shard, but
+only while the bucket has no commands in flight, which keeps the
+per-player ordering guarantee intact. Load is the number of commands
+pushed to a shard's buckets over the last REBALANCE_WINDOW: an idle shard
+takes the bucket whose recent traffic best evens it out with the busiest
+shard, and nothing moves once the two are within REBALANCE_TOLERANCE.
+
+Shards beyond `active_shards()` are parked: they hand their idle buckets
+to the active shards and sleep on their queue with a long timeout. A
+parked shard still applies anything that reaches its queue (a bucket may
+be in flight while it is deactivated), so parking never strands a command.
+ThreadPool's adaptive sizing moves the active count at runtime.
+
+Commands a shard queue discards after accepting them (DropStale expiry,
+DropOldest eviction, a CoalescingQueue merge) are reported through the
+queue's discard handler and released like applied ones, so a bucket's
+in-flight count always drains back to zero and the bucket can move again.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+#include "ThreadPool.h"
+#include "PlayerCommand.h"
+
+// Queues that can report the items they discard after accepting them
+template <typename Queue, typename T>
+concept DiscardReporting = requires (Queue& queue, std::function<void(const T&)> handler) {
+    queue.set_discard_handler(std::move(handler));
+};
+
+class ShardedDispatcher {
+private:
+    static constexpr size_t BUCKET_COUNT = 256;
+
+    // How long an idle shard waits before trying to rebalance
+    static constexpr std::chrono::milliseconds IDLE_SLICE{10};
+    // How long a parked shard sleeps between checks for stray buckets
+    static constexpr std::chrono::milliseconds PARKED_SLICE{100};
+    // Traffic is compared over windows this long; at most one bucket moves per window
+    static constexpr std::chrono::milliseconds REBALANCE_WINDOW{100};
+    // Shards whose loads differ by at most this share of the busier one (or by
+    // fewer than MIN_REBALANCE_GAP commands) count as balanced
+    static constexpr double REBALANCE_TOLERANCE = 0.25;
+    static constexpr uint64_t MIN_REBALANCE_GAP = 8;
+
+    std::vector<std::unique_ptr<CommandQueue>> m_shards;
+    std::unique_ptr<std::atomic<size_t>[]> m_shard_in_flight;
+    // Per shard: time spent applying batches, and commands applied
+    std::unique_ptr<std::atomic<uint64_t>[]> m_shard_busy_ns;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_shard_completed;
+    // Per shard: commands its queue discarded (stale, evicted or merged)
+    std::unique_ptr<std::atomic<uint64_t>[]> m_shard_discarded;
+    std::atomic<size_t> m_active_shards;
+
+    // Per bucket: owning shard in the high 32 bits, commands in flight in the
+    // low 32. Packing both lets a push take a reference on the bucket and
+    // read its owner in one atomic add, so ownership can only move while it is idle.
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_buckets;
+    std::atomic<uint64_t> m_rebalanced{0};
+
+    // Commands pushed per bucket, ever; rebalance() diffs them per window
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_bucket_pushes;
+
+    // Rebalance state; one idle shard at a time measures and moves
+    std::mutex m_rebalance_mutex;
+    std::chrono::steady_clock::time_point m_window_start;
+    std::array<uint64_t, BUCKET_COUNT> m_window_pushes{}; // m_bucket_pushes at m_window_start
+    std::vector<uint64_t> m_shard_load;                   // per shard, over the last window
+
+    static size_t bucket_of(const PlayerCommand& command) {
+        // Fibonacci hashing: top 8 bits of the product pick one of 256 buckets
+        return (static_cast<uint32_t>(command.player_id) * 2654435761u) >> 24;
+    }
+
+    // Drops the in-flight references taken by push() for commands that left the shard
+    void release(size_t shard, std::span<const PlayerCommand> commands) {
+        for (const auto& command : commands) {
+            m_buckets[bucket_of(command)].fetch_sub(1, std::memory_order_acq_rel);
+        }
+        m_shard_in_flight[shard].fetch_sub(commands.size(), std::memory_order_relaxed);
+    }
+
+    // Releases a processed batch and counts it as applied
+    void complete(size_t shard, std::span<const PlayerCommand> commands) {
+        release(shard, commands);
+        m_shard_completed[shard].fetch_add(commands.size(), std::memory_order_relaxed);
+    }
+
+    // Discard handler of a shard queue: runs under that queue's lock
+    void on_discard(size_t shard, const PlayerCommand& command) {
+        release(shard, std::span<const PlayerCommand>(&command, 1));
+        m_shard_discarded[shard].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Ring variants never discard an accepted command and have no handler
+    template <typename Queue>
+    void attach_discard_handler(Queue& queue, size_t shard) {
+        if constexpr (DiscardReporting<Queue, PlayerCommand>) {
+            queue.set_discard_handler([this, shard](const PlayerCommand& command) { on_discard(shard, command); });
+        }
+    }
+
+    template <typename BatchFn>
+    void apply_batch(size_t shard, BatchFn& on_batch, std::span<const PlayerCommand> commands) {
+        auto start = std::chrono::steady_clock::now();
+        on_batch(commands);
+        complete(shard, commands);
+        auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        m_shard_busy_ns[shard].fetch_add(static_cast<uint64_t>(busy.count()), std::memory_order_relaxed);
+        record_worker_busy(busy, commands.size());
+    }
+
+public:
+    /**
+     * @brief Creates one CommandQueue per shard and spreads the buckets evenly.
+     * @param num_shards Number of shards, normally one per worker thread; at least 1.
+     */
+    explicit ShardedDispatcher(size_t num_shards)
+        : m_shard_in_flight(new std::atomic<size_t>[num_shards]),
+          m_shard_busy_ns(new std::atomic<uint64_t>[num_shards]),
+          m_shard_completed(new std::atomic<uint64_t>[num_shards]),
+          m_shard_discarded(new std::atomic<uint64_t>[num_shards]),
+          m_active_shards(num_shards),
+          m_window_start(std::chrono::steady_clock::now()),
+          m_shard_load(num_shards, 0)
+    {
+        assert(num_shards > 0 && "ShardedDispatcher needs at least one shard");
+        for (size_t i = 0; i < num_shards; ++i) {
+            m_shards.emplace_back(new CommandQueue(make_command_queue()));
+            attach_discard_handler(*m_shards.back(), i);
+            m_shard_in_flight[i].store(0, std::memory_order_relaxed);
+            m_shard_busy_ns[i].store(0, std::memory_order_relaxed);
+            m_shard_completed[i].store(0, std::memory_order_relaxed);
+            m_shard_discarded[i].store(0, std::memory_order_relaxed);
+        }
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            m_buckets[b].store(static_cast<uint64_t>(b % num_shards) << 32, std::memory_order_relaxed);
+            m_bucket_pushes[b].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ShardedDispatcher(const ShardedDispatcher&) = delete;
+    ShardedDispatcher& operator=(const ShardedDispatcher&) = delete;
+
+    /**
+     * @brief Routes the command to the shard that currently owns its player.
+     * @return True if the shard queue accepted it
+     */
+    bool push(PlayerCommand command) {
+        const size_t b = bucket_of(command);
+        const uint64_t word = m_buckets[b].fetch_add(1, std::memory_order_acq_rel);
+        m_bucket_pushes[b].fetch_add(1, std::memory_order_relaxed);
+
+        const size_t shard = static_cast<size_t>(word >> 32);
+        m_shard_in_flight[shard].fetch_add(1, std::memory_order_relaxed);
+        const bool accepted = m_shards[shard]->push(command);
+        if (!accepted) release(shard, std::span<const PlayerCommand>(&command, 1));
+        return accepted;
+    }
+
+    /**
+     * @brief Once per REBALANCE_WINDOW, moves the bucket that best evens out
+     * `idle_shard` and the busiest active shard, judged by the commands pushed
+     * to each bucket during the window. Does nothing while their loads are
+     * within REBALANCE_TOLERANCE. Only buckets with nothing in flight are
+     * moved, so no player ever has commands queued on two shards at once.
+     * @return True if a bucket changed owner
+     */
+    bool rebalance(size_t idle_shard) {
+        const size_t active = active_shards();
+        if (idle_shard >= active) return false; // parked shards do not take buckets
+        std::unique_lock<std::mutex> lock(m_rebalance_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) return false; // another idle shard is measuring
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_window_start < REBALANCE_WINDOW) return false;
+        m_window_start = now;
+
+        // Close the window: per-bucket traffic, summed per owning shard
+        std::array<uint64_t, BUCKET_COUNT> traffic;
+        std::array<uint64_t, BUCKET_COUNT> owner_word;
+        std::fill(m_shard_load.begin(), m_shard_load.end(), 0);
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            const uint64_t pushes = m_bucket_pushes[b].load(std::memory_order_relaxed);
+            traffic[b] = pushes - m_window_pushes[b];
+            m_window_pushes[b] = pushes;
+            owner_word[b] = m_buckets[b].load(std::memory_order_relaxed);
+            m_shard_load[static_cast<size_t>(owner_word[b] >> 32)] += traffic[b];
+        }
+
+        size_t busiest = idle_shard;
+        for (size_t i = 0; i < active; ++i) {
+            if (m_shard_load[i] > m_shard_load[busiest]) busiest = i;
+        }
+        const uint64_t gap = m_shard_load[busiest] - m_shard_load[idle_shard];
+        if (busiest == idle_shard || gap < MIN_REBALANCE_GAP
+            || static_cast<double>(gap) <= REBALANCE_TOLERANCE * static_cast<double>(m_shard_load[busiest])) {
+            return false;
+        }
+
+        // Moving traffic t leaves the pair at (busiest - t, idle + t): any
+        // 0 < t < gap helps, and t nearest gap / 2 evens them out best
+        size_t best = BUCKET_COUNT;
+        uint64_t best_distance = gap;
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            if ((owner_word[b] >> 32) != busiest || traffic[b] == 0 || traffic[b] >= gap) continue;
+            const uint64_t distance = traffic[b] > gap / 2 ? traffic[b] - gap / 2 : gap / 2 - traffic[b];
+            if (distance < best_distance) {
+                best = b;
+                best_distance = distance;
+            }
+        }
+        if (best == BUCKET_COUNT) return false;
+
+        uint64_t expected = static_cast<uint64_t>(busiest) << 32; // nothing in flight
+        if (!m_buckets[best].compare_exchange_strong(expected, static_cast<uint64_t>(idle_shard) << 32,
+                                                     std::memory_order_acq_rel)) {
+            return false; // busy right now; the next window measures again
+        }
+        m_rebalanced.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Hands every idle bucket of a parked shard to the active shards.
+     * @return Number of buckets the shard still owns (they had commands in flight)
+     */
+    size_t evacuate(size_t shard) {
+        const size_t active = active_shards();
+        size_t remaining = 0;
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            uint64_t expected = static_cast<uint64_t>(shard) << 32;
+            if ((m_buckets[b].load(std::memory_order_relaxed) >> 32) != shard) continue;
+            const uint64_t to = static_cast<uint64_t>(b % active) << 32;
+            if (m_buckets[b].compare_exchange_strong(expected, to, std::memory_order_acq_rel)) {
+                m_rebalanced.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                ++remaining;
+            }
+        }
+        return remaining;
+    }
+
+    /**
+     * @brief Worker loop for one shard: applies batches from the shard's queue
+     * in order until the dispatcher is stopped and the shard is drained.
+     * Idle time is used to rebalance buckets and run periodic housekeeping;
+     * while the shard is parked it only evacuates buckets and applies strays.
+     * @param on_batch Called with each batch of commands, e.g. GameState::process_commands
+     * @param housekeeping Called about every `housekeeping_interval`
+     */
+    template <typename BatchFn, typename HousekeepingFn>
+    void run_shard(size_t shard, BatchFn on_batch, HousekeepingFn housekeeping,
+                   std::chrono::milliseconds housekeeping_interval) {
+        CommandQueue& queue = *m_shards[shard];
+        std::array<PlayerCommand, 64> batch;
+        auto next_housekeeping = std::chrono::steady_clock::now() + housekeeping_interval;
+
+        for (;;) {
+            const bool parked = shard >= active_shards();
+            const auto wait_start = std::chrono::steady_clock::now();
+            auto deadline = parked ? wait_start + PARKED_SLICE
+                                   : std::min(next_housekeeping, wait_start + IDLE_SLICE);
+            size_t count = queue.pop_bulk_until(batch, batch.size(), deadline);
+            record_worker_idle(std::chrono::steady_clock::now() - wait_start);
+            if (count > 0) {
+                apply_batch(shard, on_batch, std::span<const PlayerCommand>(batch.data(), count));
+                if (parked) evacuate(shard);
+            } else if (queue.stopped()) {
+                // Apply anything pushed just before stop(), then exit
+                while ((count = queue.pop_bulk(batch, batch.size())) > 0) {
+                    apply_batch(shard, on_batch, std::span<const PlayerCommand>(batch.data(), count));
+                }
+                break;
+            } else if (parked) {
+                evacuate(shard);
+            } else {
+                rebalance(shard);
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (!parked && now >= next_housekeeping) {
+                housekeeping();
+                next_housekeeping = now + housekeeping_interval;
+            }
+        }
+    }
+
+    /**
+     * @brief Stops every shard queue; workers exit once their shard is drained.
+     */
+    void stop() {
+        for (auto& shard : m_shards) shard->stop();
+    }
+
+    size_t shard_count() const { return m_shards.size(); }
+
+    // Shard queue access, e.g. for SafeQueue::stats() in diagnostics
+    const CommandQueue& shard(size_t index) const { return *m_shards[index]; }
+
+    /**
+     * @brief Sets how many shards (the first `count`) take new buckets; the
+     * rest park once their buckets are handed over. Clamped to [1, shard_count].
+     */
+    void set_active_shards(size_t count) {
+        m_active_shards.store(std::clamp<size_t>(count, 1, m_shards.size()), std::memory_order_relaxed);
+    }
+
+    size_t active_shards() const { return m_active_shards.load(std::memory_order_relaxed); }
+
+    // Commands pushed to a shard and not yet applied
+    size_t in_flight(size_t shard) const { return m_shard_in_flight[shard].load(std::memory_order_relaxed); }
+
+    // Cumulative time the shard's worker spent applying batches
+    uint64_t busy_ns(size_t shard) const { return m_shard_busy_ns[shard].load(std::memory_order_relaxed); }
+
+    // Cumulative commands the shard has applied
+    uint64_t completed(size_t shard) const { return m_shard_completed[shard].load(std::memory_order_relaxed); }
+
+    // Cumulative commands the shard's queue discarded after accepting them
+    uint64_t discarded(size_t shard) const { return m_shard_discarded[shard].load(std::memory_order_relaxed); }
+
+    // Number of buckets that have changed owner so far
+    uint64_t rebalanced() const { return m_rebalanced.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,496 @@
+/*
+ShmQueue.h
+Cross-process command queue in a POSIX shared-memory segment.
+
+Lets the SFML frontend and the simulation run as separate processes: the
+frontend pushes PlayerCommands, the simulation pops them, with the same
+push/pop/stop contract as SafeQueue. The ring is the bounded MPMC design
+from RingQueue.h, laid out in an mmap'd region so both processes operate
+on the same atomics; items must therefore be trivially copyable.
+
+Roles and liveness:
+- The consumer (simulation) creates the segment, replacing a stale one
+  left by a crashed run, and unlinks it when destroyed. A segment whose
+  consumer is still alive is never replaced: creating it again fails.
+- The producer (frontend) attaches to an existing segment by name.
+- Each side publishes its pid and a heartbeat. A side whose pid has
+  detached or no longer exists counts as gone: pops drain what is left and
+  then return false, pushes fail (for a crashed consumer, once the
+  ring is full). So a crashed renderer cannot wedge the simulation, and
+  vice versa. Heartbeats are refreshed while waiting; heartbeat() lets an
+  otherwise idle side show that it is not hung.
+
+Waiting uses a process-shared futex on Linux and a short sleep-poll
+elsewhere (macOS has no public cross-process wait primitive).
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#endif
+#include "QueueCommon.h"
+
+enum class ShmRole {
+    Consumer, // creates and owns the segment
+    Producer  // attaches to the consumer's segment
+};
+
+namespace shm_detail {
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory queue needs address-free lock-free atomics");
+
+constexpr uint32_t MAGIC = 0x51554531; // "QUE1"
+constexpr uint32_t VERSION = 1;
+
+// Pid values besides a real pid
+constexpr int32_t PID_NONE = 0;      // never attached
+constexpr int32_t PID_DETACHED = -1; // detached cleanly
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t item_size;
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> stop;
+    std::atomic<int32_t> producer_pid;
+    std::atomic<int32_t> consumer_pid;
+    std::atomic<int64_t> producer_heartbeat_ns;
+    std::atomic<int64_t> consumer_heartbeat_ns;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> enqueue_pos;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> dequeue_pos;
+
+    // Futex words bumped when items arrive / slots free up, plus the number
+    // of sleepers on each, so the other side only makes a syscall when needed
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> items_signal;
+    std::atomic<uint32_t> consumer_sleepers;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> space_signal;
+    std::atomic<uint32_t> producer_sleepers;
+};
+
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sleeps while word == expected, for at most `timeout`
+inline void wait_on(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+#ifdef __linux__
+    timespec ts{static_cast<time_t>(timeout.count() / 1000000000), static_cast<long>(timeout.count() % 1000000000)};
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    if (word.load(std::memory_order_acquire) == expected) {
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, std::chrono::microseconds(200)));
+    }
+#endif
+}
+
+inline void wake_all(std::atomic<uint32_t>& word) {
+    word.fetch_add(1, std::memory_order_seq_cst);
+#ifdef __linux__
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+inline bool pid_gone(int32_t pid) {
+    if (pid == PID_DETACHED) return true;
+    if (pid == PID_NONE) return false;
+    return ::kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+} // namespace shm_detail
+
+template <typename T>
+class ShmQueue {
+    static_assert(std::is_trivially_copyable_v<T>, "ShmQueue items are copied between processes as raw bytes");
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        T data;
+    };
+
+    static constexpr int SPIN_LIMIT = 64;
+    // Longest single sleep; bounds how late a dead peer or stop is noticed
+    static constexpr std::chrono::milliseconds LIVENESS_SLICE{100};
+    // How long a producer waits for the consumer to create the segment
+    static constexpr std::chrono::seconds ATTACH_TIMEOUT{5};
+
+    std::string m_name;
+    ShmRole m_role;
+    void* m_region = MAP_FAILED;
+    size_t m_region_size = 0;
+    shm_detail::Header* m_header = nullptr;
+    Cell* m_cells = nullptr;
+    uint64_t m_mask = 0;
+
+    static size_t region_size(uint64_t capacity) {
+        return sizeof(shm_detail::Header) + capacity * sizeof(Cell);
+    }
+
+    [[noreturn]] static void fail(const char* what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void map(int fd, size_t size) {
+        m_region = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m_region == MAP_FAILED) {
+            ::close(fd);
+            fail("mmap");
+        }
+        m_region_size = size;
+        m_header = static_cast<shm_detail::Header*>(m_region);
+        m_cells = reinterpret_cast<Cell*>(static_cast<char*>(m_region) + sizeof(shm_detail::Header));
+    }
+
+    /**
+     * @brief True if a segment with our name exists and its consumer is a
+     * live process, i.e. another simulation (or queue) is using it.
+     */
+    bool owned_by_live_consumer() const {
+        int fd = ::shm_open(m_name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        bool live = false;
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(shm_detail::Header)) {
+            void* region = ::mmap(nullptr, sizeof(shm_detail::Header), PROT_READ, MAP_SHARED, fd, 0);
+            if (region != MAP_FAILED) {
+                const auto* header = static_cast<const shm_detail::Header*>(region);
+                const int32_t pid = header->consumer_pid.load(std::memory_order_acquire);
+                live = header->magic == shm_detail::MAGIC && pid > 0 && !shm_detail::pid_gone(pid);
+                ::munmap(region, sizeof(shm_detail::Header));
+            }
+        }
+        ::close(fd);
+        return live;
+    }
+
+    void create(size_t capacity) {
+        const uint64_t cap = round_up_pow2(capacity);
+        if (owned_by_live_consumer()) {
+            errno = EBUSY;
+            fail("ShmQueue segment is in use by a live consumer");
+        }
+        ::shm_unlink(m_name.c_str()); // a stale segment from a crashed run
+        int fd = ::shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) fail("shm_open");
+        if (::ftruncate(fd, static_cast<off_t>(region_size(cap))) != 0) {
+            ::close(fd);
+            ::shm_unlink(m_name.c_str());
+            fail("ftruncate");
+        }
+        map(fd, region_size(cap));
+        ::close(fd);
+
+        auto* header = new (m_region) shm_detail::Header{};
+        header->magic = shm_detail::MAGIC;
+        header->version = shm_detail::VERSION;
+        header->capacity = cap;
+        header->item_size = sizeof(T);
+        for (uint64_t i = 0; i < cap; ++i) {
+            new (&m_cells[i]) Cell{};
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_mask = cap - 1;
+        // Claimed before it is marked ready, so a concurrent create() sees a live owner
+        header->consumer_pid.store(static_cast<int32_t>(::getpid()), std::memory_order_release);
+        header->ready.store(1, std::memory_order_release);
+    }
+
+    void attach() {
+        const auto give_up = std::chrono::steady_clock::now() + ATTACH_TIMEOUT;
+        for (;;) {
+            int fd = ::shm_open(m_name.c_str(), O_RDWR, 0600);
+            if (fd >= 0) {
+                struct stat st{};
+                if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(shm_detail::Header)) {
+                    map(fd, static_cast<size_t>(st.st_size));
+                    ::close(fd);
+                    if (m_header->ready.load(std::memory_order_acquire) == 1) break;
+                    ::munmap(m_region, m_region_size);
+                    m_region = MAP_FAILED;
+                } else {
+                    ::close(fd);
+                }
+            }
+            if (std::chrono::steady_clock::now() >= give_up) {
+                errno = ETIMEDOUT;
+                fail("ShmQueue attach");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (m_header->magic != shm_detail::MAGIC || m_header->version != shm_detail::VERSION
+            || m_header->item_size != sizeof(T) || region_size(m_header->capacity) > m_region_size) {
+            errno = EPROTO;
+            fail("ShmQueue layout mismatch");
+        }
+        m_mask = m_header->capacity - 1;
+    }
+
+    std::atomic<int32_t>& own_pid() {
+        return m_role == ShmRole::Consumer ? m_header->consumer_pid : m_header->producer_pid;
+    }
+    std::atomic<int32_t>& peer_pid() {
+        return m_role == ShmRole::Consumer ? m_header->producer_pid : m_header->consumer_pid;
+    }
+    std::atomic<int64_t>& own_heartbeat() {
+        return m_role == ShmRole::Consumer ? m_header->consumer_heartbeat_ns : m_header->producer_heartbeat_ns;
+    }
+    const std::atomic<int64_t>& peer_heartbeat() const {
+        return m_role == ShmRole::Consumer ? m_header->producer_heartbeat_ns : m_header->consumer_heartbeat_ns;
+    }
+
+    bool try_enqueue(const T& item) {
+        uint64_t pos = m_header->enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            int64_t dif = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (dif == 0) {
+                if (m_header->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = m_header->enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_dequeue(T& item) {
+        uint64_t pos = m_header->dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            int64_t dif = static_cast<int64_t>(seq) - static_cast<int64_t>(pos + 1);
+            if (dif == 0) {
+                if (m_header->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false; // empty
+            } else {
+                pos = m_header->dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Wakes the other side's sleepers on `signal`, skipping the syscall if there are none
+    static void notify(std::atomic<uint32_t>& signal, std::atomic<uint32_t>& sleepers) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0) shm_detail::wake_all(signal);
+    }
+
+    /**
+     * @brief Retries `attempt` until it succeeds, `give_up` holds or the
+     * deadline passes, sleeping on `signal` between tries.
+     */
+    template <typename Attempt, typename GiveUp, typename Deadline>
+    bool wait_for(Attempt attempt, GiveUp give_up, std::atomic<uint32_t>& signal,
+                  std::atomic<uint32_t>& sleepers, const Deadline& deadline) {
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (attempt()) return true;
+            cpu_relax();
+        }
+        for (;;) {
+            heartbeat();
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const uint32_t seen = signal.load(std::memory_order_seq_cst);
+            bool done = attempt();
+            bool abandon = !done && (give_up() || deadline_passed(deadline));
+            if (!done && !abandon) {
+                std::chrono::nanoseconds slice = LIVENESS_SLICE;
+                if constexpr (!std::is_same_v<Deadline, NoDeadline>) {
+                    slice = std::min<std::chrono::nanoseconds>(slice, deadline - Deadline::clock::now());
+                }
+                if (slice.count() > 0) shm_detail::wait_on(signal, seen, slice);
+            }
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            if (done) return true;
+            if (abandon) return attempt();
+        }
+    }
+
+    template <typename Deadline>
+    bool wait_and_dequeue(T& item, const Deadline& deadline) {
+        bool got = wait_for([&] { return try_dequeue(item); },
+                            [this] { return stopped() || !peer_alive(); },
+                            m_header->items_signal, m_header->consumer_sleepers, deadline);
+        if (got) notify(m_header->space_signal, m_header->producer_sleepers);
+        return got;
+    }
+
+public:
+    /**
+     * @brief Creates (consumer) or attaches to (producer) the named segment.
+     * @param name POSIX shm name, e.g. "/flappy_commands"
+     * @param capacity Ring size for the consumer, rounded up to a power of two; ignored by producers
+     * @throws std::system_error if the segment cannot be created (EBUSY: a live
+     * consumer already owns the name), attached or does not match T
+     */
+    ShmQueue(std::string name, ShmRole role, size_t capacity = 1024)
+        : m_name(std::move(name)), m_role(role)
+    {
+        if (m_role == ShmRole::Consumer) create(capacity);
+        else attach();
+        own_pid().store(static_cast<int32_t>(::getpid()), std::memory_order_release);
+        heartbeat();
+    }
+
+    ~ShmQueue() {
+        if (m_region == MAP_FAILED) return;
+        own_pid().store(shm_detail::PID_DETACHED, std::memory_order_release);
+        // Wake the peer so it notices we left
+        shm_detail::wake_all(m_header->items_signal);
+        shm_detail::wake_all(m_header->space_signal);
+        ::munmap(m_region, m_region_size);
+        if (m_role == ShmRole::Consumer) ::shm_unlink(m_name.c_str());
+    }
+
+    ShmQueue(const ShmQueue&) = delete;
+    ShmQueue& operator=(const ShmQueue&) = delete;
+
+    /**
+     * @brief Push an item (producer side). Waits for a free slot if the ring is full.
+     * @return True if the item was enqueued, false if the queue is stopped or the consumer is gone
+     */
+    bool push(T item) {
+        if (stopped() || peer_pid().load(std::memory_order_relaxed) == shm_detail::PID_DETACHED) return false;
+        bool pushed = wait_for([&] { return try_enqueue(item); },
+                               [this] { return stopped() || !peer_alive(); },
+                               m_header->space_signal, m_header->producer_sleepers, NoDeadline{});
+        if (!pushed) return false;
+        notify(m_header->items_signal, m_header->consumer_sleepers);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item (consumer side)
+     * @return True if an item was popped, false if the queue is stopped (or the producer gone) and empty
+     */
+    bool pop(T& item) {
+        return wait_and_dequeue(item, NoDeadline{});
+    }
+
+    /**
+     * @brief Pop an item without waiting
+     * @return True if an item was popped, false if the ring was empty
+     */
+    bool try_pop(T& item) {
+        if (!try_dequeue(item)) return false;
+        notify(m_header->space_signal, m_header->producer_sleepers);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item, waiting at most until the deadline
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_and_dequeue(item, deadline);
+    }
+
+    /**
+     * @brief Pop an item, waiting at most for the given duration
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Pop up to max items, waiting for the first one
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0 || !pop(out[0])) return 0;
+        size_t count = 1;
+        while (count < max && try_pop(out[count])) ++count;
+        return count;
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0 || !pop_until(out[0], deadline)) return 0;
+        size_t count = 1;
+        while (count < max && try_pop(out[count])) ++count;
+        return count;
+    }
+
+    /**
+     * signals queue to stop (visible to both processes), wakes up all waiting threads
+    */
+    void stop() {
+        m_header->stop.store(1, std::memory_order_release);
+        shm_detail::wake_all(m_header->items_signal);
+        shm_detail::wake_all(m_header->space_signal);
+    }
+
+    /**
+     * @brief True once either process has called stop() (items may still be queued)
+     */
+    bool stopped() const {
+        return m_header->stop.load(std::memory_order_acquire) != 0;
+    }
+
+    /**
+     * @brief False once the other process has detached or died.
+     * A peer that has not attached yet still counts as alive.
+     */
+    bool peer_alive() {
+        return !shm_detail::pid_gone(peer_pid().load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief Time since the other process last touched the queue; a live pid
+     * with a growing age points at a hung rather than a crashed peer.
+     */
+    std::chrono::nanoseconds peer_heartbeat_age() const {
+        int64_t last = peer_heartbeat().load(std::memory_order_relaxed);
+        if (last == 0) return std::chrono::nanoseconds::zero();
+        return std::chrono::nanoseconds(shm_detail::now_ns() - last);
+    }
+
+    // Refreshes this side's heartbeat; call from idle loops
+    void heartbeat() {
+        own_heartbeat().store(shm_detail::now_ns(), std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+};
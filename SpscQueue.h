@@ -0,0 +1,258 @@
+/*
+SpscQueue.h
+Wait-free single-producer/single-consumer ring buffer.
+
+Intended for the common deployment where only the SFML event loop pushes
+commands and a single worker consumes them. push() and the item-available
+path of pop() are a handful of loads and stores: no locks, no CAS and no
+syscalls. The consumer spins with a CPU pause while the queue is empty,
+then yields, and after a longer idle period parks: untimed pops on an
+std::atomic::wait event count, timed pops on a condition variable. As in
+SafeQueue's SpinThenPark, the producer only issues a wake (or takes the
+park mutex) when the consumer has actually parked.
+
+Using it with more than one producer or more than one consumer is a bug.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include "QueueCommon.h"
+
+template <typename T>
+class SpscQueue {
+private:
+    static constexpr int SPIN_LIMIT = 4096; // pause-spins before the consumer starts yielding
+    static constexpr int YIELD_LIMIT = 64;  // yields before the consumer parks
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_buffer;
+
+    // Consumer-owned line: read index plus the producer's index as last seen
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head{0};
+    size_t m_cached_tail = 0;
+
+    // Producer-owned line: write index plus the consumer's index as last seen
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail{0};
+    size_t m_cached_head = 0;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> m_stop{false};
+
+    // Parking for an idle consumer: m_epoch is the event count untimed pops
+    // wait on, m_park_cv serves timed pops (atomic::wait cannot time out)
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_epoch{0};
+    std::atomic<uint32_t> m_parked{0};
+    std::mutex m_park_mutex;
+    std::condition_variable m_park_cv;
+
+    bool try_enqueue(T& item) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == m_capacity) {
+            // Only re-read the shared head when our cached copy says we're full
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == m_capacity) return false;
+        }
+        m_buffer[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_dequeue(T& item) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) return false;
+        }
+        item = std::move(m_buffer[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves out everything published so far (up to out.size()) with a single
+    // acquire of the tail and a single release of the head
+    size_t try_dequeue_bulk(std::span<T> out) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+        }
+        const size_t count = std::min(m_cached_tail - head, out.size());
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = std::move(m_buffer[(head + i) & m_mask]);
+        }
+        if (count > 0) m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // True once an item is published or stop() was called (consumer side)
+    bool ready() const {
+        return m_tail.load(std::memory_order_seq_cst) != m_head.load(std::memory_order_relaxed) ||
+               m_stop.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief Sleeps until the producer publishes, stop() is called or the
+     * deadline passes. Registers as parked before the final check, so a
+     * concurrent push either sees us in m_parked or we see its item.
+     */
+    template <typename Deadline>
+    void park(const Deadline& deadline) {
+        m_parked.fetch_add(1, std::memory_order_seq_cst);
+        if constexpr (std::is_same_v<Deadline, NoDeadline>) {
+            const uint32_t epoch = m_epoch.load(std::memory_order_seq_cst);
+            if (!ready()) m_epoch.wait(epoch, std::memory_order_seq_cst);
+        } else {
+            std::unique_lock<std::mutex> lock(m_park_mutex);
+            m_park_cv.wait_until(lock, deadline, [this] { return ready(); });
+        }
+        m_parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Wakes a parked consumer after a push; a fence and a load when nobody sleeps
+    void wake_consumer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_parked.load(std::memory_order_relaxed) == 0) return;
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        m_epoch.notify_one();
+        std::lock_guard<std::mutex> lock(m_park_mutex);
+        m_park_cv.notify_one();
+    }
+
+    // Spins, yields, then parks until an item arrives, the queue is stopped or the deadline passes
+    template <typename Deadline>
+    bool wait_and_dequeue(T& item, const Deadline& deadline) {
+        int spins = 0;
+        while (!try_dequeue(item)) {
+            if (m_stop.load(std::memory_order_acquire)) return try_dequeue(item);
+            if (++spins < SPIN_LIMIT) {
+                if ((spins & 63) == 0 && deadline_passed(deadline)) return try_dequeue(item);
+                cpu_relax();
+            } else {
+                if (deadline_passed(deadline)) return try_dequeue(item);
+                if (spins < SPIN_LIMIT + YIELD_LIMIT) {
+                    std::this_thread::yield(); // idle for a while: give the core back
+                } else {
+                    park(deadline); // idle for long: sleep until the producer wakes us
+                }
+            }
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @brief Constructs the queue.
+     * @param capacity Requested number of slots, rounded up to a power of two.
+     */
+    explicit SpscQueue(size_t capacity = 1024)
+        : m_capacity(round_up_pow2(capacity)),
+          m_mask(m_capacity - 1),
+          m_buffer(new T[m_capacity])
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Push an item (producer thread only).
+     * Waits for a free slot if the consumer has fallen a full ring behind.
+     * @return True if the item was enqueued, false if the queue is stopped
+     */
+    bool push(T item) {
+        if (m_stop.load(std::memory_order_acquire)) return false;
+        while (!try_enqueue(item)) {
+            if (m_stop.load(std::memory_order_relaxed)) return false;
+            std::this_thread::yield();
+        }
+        wake_consumer();
+        return true;
+    }
+
+    /**
+     * @brief Pop an item from the queue (consumer thread only)
+     * @param item Reference to store the popped value
+     * @return True if an item was popped, false if the queue is stopped and empty
+     */
+    bool pop(T& item) {
+        return wait_and_dequeue(item, NoDeadline{});
+    }
+
+    /**
+     * @brief Pop an item without waiting (consumer thread only)
+     * @return True if an item was popped, false if the queue was empty
+     */
+    bool try_pop(T& item) {
+        return try_dequeue(item);
+    }
+
+    /**
+     * @brief Pop an item, waiting at most until the deadline (consumer thread only)
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_and_dequeue(item, deadline);
+    }
+
+    /**
+     * @brief Pop an item, waiting at most for the given duration (consumer thread only)
+     * @return True if an item was popped, false on timeout or if the queue is stopped and empty
+     */
+    template <typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(item, std::chrono::steady_clock::now() + timeout);
+    }
+
+    /**
+     * @brief Pop up to max items into a caller-provided buffer (consumer thread only)
+     * Blocks until at least one item is available or the queue is stopped.
+     * @return Number of items popped, 0 if the queue is stopped and empty
+     */
+    size_t pop_bulk(std::span<T> out, size_t max) {
+        max = std::min(max, out.size());
+        if (max == 0 || !pop(out[0])) return 0;
+        return 1 + try_dequeue_bulk(out.subspan(1, max - 1));
+    }
+
+    /**
+     * @brief Like pop_bulk, but gives up when the deadline passes (consumer thread only)
+     * @return Number of items popped, 0 on timeout or if the queue is stopped and empty
+     */
+    template <typename Clock, typename Duration>
+    size_t pop_bulk_until(std::span<T> out, size_t max, const std::chrono::time_point<Clock, Duration>& deadline) {
+        max = std::min(max, out.size());
+        if (max == 0 || !pop_until(out[0], deadline)) return 0;
+        return 1 + try_dequeue_bulk(out.subspan(1, max - 1));
+    }
+
+    /**
+     * signals queue to stop; the consumer exits once the queue is drained
+    */
+    void stop() {
+        m_stop.store(true, std::memory_order_seq_cst);
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        m_epoch.notify_all();
+        std::lock_guard<std::mutex> lock(m_park_mutex);
+        m_park_cv.notify_all();
+    }
+
+    /**
+     * @brief True once stop() has been called (items may still be queued)
+     */
+    bool stopped() const {
+        return m_stop.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return m_capacity; }
+};
@@ -0,0 +1,114 @@
+/*
+Task.h
+Move-only, type-erased `void()` callable with small-buffer storage.
+
+The unit of work for ThreadPool::post/submit. Callables up to
+TASK_INLINE_SIZE bytes (typical lambdas capturing a few pointers or a
+packaged_task) are stored inside the Task itself, so scheduling them
+needs no heap allocation; larger ones fall back to the heap. Unlike
+std::function, a Task can hold move-only callables.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Inline storage per task; keeps sizeof(Task) at one cache line
+constexpr std::size_t TASK_INLINE_SIZE = 48;
+
+class Task {
+private:
+    // Per-callable-type operations, one static table per type
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to); // move-constructs into `to`, destroys `from`
+        void (*destroy)(void* storage);
+    };
+
+    template <typename F>
+    static constexpr bool fits_inline =
+        sizeof(F) <= TASK_INLINE_SIZE &&
+        alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<F>;
+
+    template <typename F>
+    struct InlineOps {
+        static F& get(void* storage) { return *std::launder(static_cast<F*>(storage)); }
+        static void invoke(void* storage) { get(storage)(); }
+        static void move(void* from, void* to) {
+            ::new (to) F(std::move(get(from)));
+            get(from).~F();
+        }
+        static void destroy(void* storage) { get(storage).~F(); }
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    template <typename F>
+    struct HeapOps {
+        static F*& get(void* storage) { return *std::launder(static_cast<F**>(storage)); }
+        static void invoke(void* storage) { (*get(storage))(); }
+        static void move(void* from, void* to) {
+            ::new (to) F*(get(from));
+        }
+        static void destroy(void* storage) { delete get(storage); }
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char m_storage[TASK_INLINE_SIZE];
+    const Ops* m_ops = nullptr;
+    bool m_inline = true;
+
+    void reset() {
+        if (m_ops) m_ops->destroy(m_storage);
+        m_ops = nullptr;
+    }
+
+    void take(Task& other) noexcept {
+        if (!other.m_ops) return;
+        other.m_ops->move(other.m_storage, m_storage);
+        m_ops = other.m_ops;
+        m_inline = other.m_inline;
+        other.m_ops = nullptr;
+    }
+
+public:
+    Task() = default;
+
+    template <typename F, typename Fn = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same_v<Fn, Task> && std::is_invocable_v<Fn&>>>
+    Task(F&& callable) {
+        if constexpr (fits_inline<Fn>) {
+            ::new (static_cast<void*>(m_storage)) Fn(std::forward<F>(callable));
+            m_ops = &InlineOps<Fn>::ops;
+        } else {
+            ::new (static_cast<void*>(m_storage)) Fn*(new Fn(std::forward<F>(callable)));
+            m_ops = &HeapOps<Fn>::ops;
+            m_inline = false;
+        }
+    }
+
+    Task(Task&& other) noexcept { take(other); }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { m_ops->invoke(m_storage); }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+    // True if the callable lives in the inline buffer (no heap allocation)
+    bool is_inline() const { return m_inline; }
+};
@@ -0,0 +1,135 @@
+/*
+ThreadArena.h
+Per-thread monotonic arenas for scratch allocations in the hot paths.
+
+Each thread has one ArenaResource, a std::pmr::memory_resource that bumps
+a pointer through a list of blocks and never frees individual
+allocations. An ArenaScope marks the arena on entry and rewinds it on
+exit; the blocks are kept, so once a thread has seen its largest tick or
+task, scratch containers (std::pmr::vector and friends) cost no global
+heap allocation at all.
+
+The ThreadPool opens a scope around every task and the FrameGraph around
+every stage, so memory taken from thread_arena() inside them is released
+when they end. Nothing allocated from the arena may outlive the scope it
+was allocated in, or be handed to another thread that does.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+class ArenaResource : public std::pmr::memory_resource {
+private:
+    static constexpr size_t FIRST_BLOCK_SIZE = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_block = 0;  // block currently being filled
+    size_t m_offset = 0; // bytes used in it
+    size_t m_high_water = 0;
+
+    size_t used() const {
+        size_t total = m_offset;
+        for (size_t i = 0; i < m_block && i < m_blocks.size(); ++i) total += m_blocks[i].size;
+        return total;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        for (;;) {
+            if (m_block < m_blocks.size()) {
+                Block& block = m_blocks[m_block];
+                void* ptr = block.data.get() + m_offset;
+                size_t space = block.size - m_offset;
+                if (std::align(alignment, bytes, ptr, space)) {
+                    m_offset = static_cast<size_t>(static_cast<std::byte*>(ptr) - block.data.get()) + bytes;
+                    m_high_water = std::max(m_high_water, used());
+                    return ptr;
+                }
+                // Does not fit: move on to the next retained block
+                ++m_block;
+                m_offset = 0;
+                continue;
+            }
+            // Out of blocks: grow geometrically (the only time the arena allocates)
+            size_t size = std::max(m_blocks.empty() ? FIRST_BLOCK_SIZE : m_blocks.back().size * 2,
+                                   bytes + alignment);
+            m_blocks.push_back(Block{std::make_unique<std::byte[]>(size), size});
+            m_block = m_blocks.size() - 1;
+            m_offset = 0;
+        }
+    }
+
+    // Monotonic: memory comes back only when a scope rewinds
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    // Position in the arena to rewind to
+    struct Mark {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    ArenaResource() = default;
+    ArenaResource(const ArenaResource&) = delete;
+    ArenaResource& operator=(const ArenaResource&) = delete;
+
+    Mark mark() const { return Mark{m_block, m_offset}; }
+
+    // Releases everything allocated since `mark`; blocks are kept for reuse
+    void rewind(Mark mark) {
+        m_block = mark.block;
+        m_offset = mark.offset;
+    }
+
+    void reset() { rewind(Mark{}); }
+
+    // Bytes reserved from the heap, and the most ever in use at once
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : m_blocks) total += block.size;
+        return total;
+    }
+    size_t high_water() const { return m_high_water; }
+};
+
+/**
+ * @brief The calling thread's arena.
+ */
+inline ArenaResource& thread_arena() {
+    thread_local ArenaResource arena;
+    return arena;
+}
+
+/**
+ * Rewinds the calling thread's arena to where it was when the scope opened.
+ * Scopes nest; containers using the arena must be destroyed first.
+ */
+class ArenaScope {
+private:
+    ArenaResource& m_arena;
+    ArenaResource::Mark m_mark;
+
+public:
+    ArenaScope() : m_arena(thread_arena()), m_mark(m_arena.mark()) {}
+    ~ArenaScope() { m_arena.rewind(m_mark); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ArenaResource& arena() { return m_arena; }
+};
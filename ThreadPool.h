@@ -6,35 +6,265 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <chrono>
+#include <future>
+#include <type_traits>
+#include <utility>
+#include <mutex>
+#include <deque>
+#include <memory_resource>
+#include <random>
+#include <exception>
+#include <algorithm>
+#include <condition_variable>
 #include "SafeQueue.h"       // Includes the SafeQueue definition
+#include "RingQueue.h"       // Lock-free alternative with the same contract
+#include "SpscQueue.h"       // Single-producer/single-consumer variant
+#include "CoalescingQueue.h" // Merges pending commands per player/action
+#include "LaneQueue.h"       // Priority lanes for control/gameplay/bulk traffic
+#include "EventfdQueue.h"    // Waitable through a file descriptor (epoll/poll)
 #include "PlayerCommand.h"   // Includes the PlayerCommand definition
+#include "Task.h"            // Small-buffer task storage for post/submit
+#include "WorkStealingDeque.h" // Per-worker task deques
+#include "CpuAffinity.h"     // Optional pinning of workers and the render thread
+#include "AdaptiveSizing.h"  // Runtime worker-count decisions for sharded mode
+#include "ThreadArena.h"     // Per-thread scratch arenas, rewound after every task
+#include "PhaseBarrier.h"    // Lockstep barrier for run_lockstep
+#include "WorkerMetrics.h"   // Per-worker busy/idle/lock-wait accounting
 
 // 1. Define the specific Queue type used by the ThreadPool
+// Build with -DCOMMAND_QUEUE_RING to use the lock-free RingQueue instead of
+// the mutex/condition_variable SafeQueue. All variants provide push, pop,
+// try_pop, pop_for, pop_until, pop_bulk, pop_bulk_until, stop and stopped.
+// -DCOMMAND_QUEUE_SPSC selects SpscQueue, which requires exactly one
+// producer and one consumer per queue (the sharded dispatcher gives each
+// worker its own queue, fed only by the input thread). -DCOMMAND_QUEUE_COALESCING selects
+// CoalescingQueue, which merges repeated commands from the same player.
+// -DCOMMAND_QUEUE_LANES selects LaneQueue, which keeps gameplay input in its
+// own bounded lane so bulk traffic cannot delay it. -DCOMMAND_QUEUE_EVENTFD
+// selects EventfdQueue, whose fd() can be added to an epoll loop.
+#if defined(COMMAND_QUEUE_RING)
+using CommandQueue = RingQueue<PlayerCommand>;
+#elif defined(COMMAND_QUEUE_SPSC)
+using CommandQueue = SpscQueue<PlayerCommand>;
+#elif defined(COMMAND_QUEUE_COALESCING)
+using CommandQueue = CoalescingQueue<PlayerCommand, PlayerActionKey>;
+#elif defined(COMMAND_QUEUE_LANES)
+using CommandQueue = LaneQueue<PlayerCommand, PlayerCommandLane>;
+#elif defined(COMMAND_QUEUE_EVENTFD)
+using CommandQueue = EventfdQueue<PlayerCommand>;
+#else
 using CommandQueue = SafeQueue<PlayerCommand>;
+#endif
+
+// Bound on queued commands, and the age after which a FLAP is not worth applying
+const size_t COMMAND_QUEUE_CAPACITY = 1024;
+const std::chrono::milliseconds MAX_COMMAND_AGE(250);
+
+/**
+ * @brief Builds the selected CommandQueue with the bounds above.
+ * SafeQueue sheds stale commands instead of blocking the input thread;
+ * the ring variants are bounded by construction, the coalescing queue
+ * by the number of distinct players and actions, and the lane queue per lane.
+ * The eventfd queue is unbounded.
+ */
+inline CommandQueue make_command_queue() {
+#if defined(COMMAND_QUEUE_RING) || defined(COMMAND_QUEUE_SPSC)
+    return CommandQueue(COMMAND_QUEUE_CAPACITY);
+#elif defined(COMMAND_QUEUE_COALESCING) || defined(COMMAND_QUEUE_EVENTFD)
+    return CommandQueue();
+#elif defined(COMMAND_QUEUE_LANES)
+    // Indexed by CommandLane: control, gameplay, bulk. The lanes are fed from
+    // the render thread, so none of them blocks: a full control lane (256
+    // pending session changes) rejects the push and the caller sees false.
+    return CommandQueue({
+        LaneConfig{256, OverflowPolicy::DropNewest, {}, 4},
+        LaneConfig{COMMAND_QUEUE_CAPACITY, OverflowPolicy::DropStale, MAX_COMMAND_AGE, 8},
+        LaneConfig{4 * COMMAND_QUEUE_CAPACITY, OverflowPolicy::DropOldest, {}, 1}
+    }, LaneScheduling::Weighted);
+#else
+    QueueConfig config{COMMAND_QUEUE_CAPACITY, OverflowPolicy::DropStale, MAX_COMMAND_AGE};
+    config.instrument = true; // shard depth and queue wait feed adaptive sizing
+    return CommandQueue(config);
+#endif
+}
 
 // 2. Define the signature for the worker function (the entire loop)
 using WorkerTaskFunc = std::function<void(CommandQueue&)>;
 
+// 3. Sharded mode: each worker runs the loop for its own shard of the dispatcher
+class ShardedDispatcher;
+using ShardWorkerFunc = std::function<void(ShardedDispatcher&, size_t shard)>;
+
+// 4. Task mode: general work (collision batches, serialization, room ticks)
+// submitted with post()/submit() and run by the pool's task workers.
+// Each task worker owns a work-stealing deque: tasks posted from a task
+// worker stay on its deque (LIFO, cache-warm) unless an idle worker steals
+// them (FIFO); tasks posted from any other thread go to a shared injection
+// queue.
+
+// 5. Adaptive sizing (sharded mode): a controller thread samples the shards
+// every interval and parks or unparks shard workers within min/max bounds
+// (see AdaptiveSizing.h). Every change is logged and kept in resize_log().
+
+// 6. Metrics: every worker accounts its busy, idle and lock-wait time, tasks
+// and steals in its own thread-local counters (see WorkerMetrics.h);
+// metrics() snapshots them all.
+
+// 7. Lockstep mode: run_lockstep() advances a fixed group of participants
+// tick by tick, separated by a PhaseBarrier, for work that must stay in
+// sync (e.g. tournament rooms). The caller is participant 0 and the others
+// run as tasks, one per task worker, so a lockstep run occupies that many
+// task workers until its last tick and cannot have more participants than
+// there are workers to run them (max_lockstep_participants()).
+
 
 /** The ThreadPool is a consumer of the SafeQueue<PlayerCommand>.\n * It manages a fixed number of worker threads that continuously\n * pull tasks from the queue (via the provided handler) and update\n * shared state.\n*/
 class ThreadPool {
 private:
     std::vector<std::thread> m_threads;
 
-    // Reference to the thread-safe queue containing commands (tasks)
-    CommandQueue& m_command_queue;
+    // The thread-safe queue containing commands (tasks), shared by all workers
+    CommandQueue* m_command_queue = nullptr;
 
     // The user-provided function that each worker thread will execute
     WorkerTaskFunc m_worker_task_func;
 
+    // Sharded mode: worker i runs m_shard_worker_func on shard i instead
+    ShardedDispatcher* m_dispatcher = nullptr;
+    ShardWorkerFunc m_shard_worker_func;
+
+    // Workers running the command loop (or shard loop), if any
     const size_t m_num_threads;
+    // Additional workers that only run posted/submitted tasks
+    const size_t m_num_task_threads;
     std::atomic<bool> m_joined;
 
+    // Applied by start(); PlacementMode::None leaves threads unpinned
+    PlacementConfig m_placement;
+
+    // One block per thread in m_threads, written only by that worker; created by start()
+    std::vector<std::unique_ptr<WorkerCounters>> m_worker_counters;
+
+    // Adaptive sizing, if enabled: the controller thread and its resize log
+    static constexpr size_t RESIZE_LOG_CAPACITY = 256;
+    std::unique_ptr<AdaptiveSizer> m_sizer;
+    std::thread m_sizer_thread;
+    mutable std::mutex m_sizer_mutex;
+    std::condition_variable m_sizer_cv;
+    bool m_sizer_stop = false;
+    std::vector<ResizeEvent> m_resize_log;
+
+    struct TaskWorker {
+        WorkStealingDeque<Task> deque;
+        std::minstd_rand rng; // victim selection
+    };
+    std::vector<std::unique_ptr<TaskWorker>> m_task_workers;
+
+    // Tasks posted from outside the task workers; m_tasks_stopped is set under m_inject_mutex
+    mutable std::mutex m_inject_mutex;
+    std::pmr::unsynchronized_pool_resource m_inject_memory; // recycles m_injected's blocks
+    std::pmr::deque<Task*> m_injected{&m_inject_memory};
+    bool m_tasks_stopped = false;
+
+    // Task nodes are cached per thread; threads that free more than they post
+    // (the ones running tasks) spill batches here for the ones that post more
+    // than they run (the render thread), so steady-state posting never allocates
+    std::mutex m_node_mutex;
+    std::vector<Task*> m_spare_nodes;
+
+    // Tasks queued anywhere and not yet taken, plus an event count for idle
+    // task workers: posting only touches m_task_signal when someone sleeps
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_pending_tasks{0};
+    std::atomic<bool> m_task_stop{false};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_task_signal{0};
+    std::atomic<uint32_t> m_task_sleepers{0};
+
     /**
      * @brief The main function executed by each worker thread.
-     * It simply calls the user-provided worker_task_func.
+     * It simply calls the user-provided worker function.
+     * @param index The worker's index (its shard in sharded mode).
      */
-    void worker_loop();
+    void worker_loop(size_t index);
+
+    // Loop of a task worker: runs tasks until the pool is joined
+    void task_loop(size_t worker);
+
+    // Queues a task on the calling worker's deque or the injection queue
+    void schedule(Task&& task);
+
+    /**
+     * @brief Next task for the calling thread: its own deque (if it is a task
+     * worker), then the injection queue, then a steal from a random victim.
+     * @return nullptr if nothing was found
+     */
+    Task* find_task(TaskWorker* self);
+
+    void wake_task_worker();
+
+    // Stops accepting external tasks; task workers exit once all are done
+    void stop_tasks();
+
+    // Pins the render thread and workers per m_placement and logs the layout
+    void apply_placement();
+
+    // Controller thread for adaptive sizing: samples, decides, resizes, logs
+    void sizing_loop();
+
+    // Wakes the controller thread and waits for it to exit
+    void stop_sizer();
+
+    // Automatic grain: about CHUNKS_PER_WORKER chunks per participating
+    // thread balances uneven chunks, MIN_GRAIN keeps per-chunk overhead small
+    static constexpr size_t CHUNKS_PER_WORKER = 4;
+    static constexpr size_t MIN_GRAIN = 16;
+
+    /**
+     * A range split into chunks, claimed by the caller and helper tasks.
+     * Shared with the helpers, which may start after the caller has
+     * returned; they then find no chunk left and never touch `run`/`fn`.
+     * Jobs are pooled: the caller and each helper hold a reference, and
+     * the last one to let go returns the job to m_spare_jobs.
+     */
+    struct ChunkJob {
+        std::atomic<size_t> refs{0};
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t begin = 0;
+        size_t end = 0;
+        size_t grain = 1;
+        size_t chunks = 0;
+        void (*run)(void* fn, size_t chunk, size_t chunk_begin, size_t chunk_end) = nullptr;
+        void* fn = nullptr;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error; // written once, by whoever sets `failed`
+
+        // Claims and runs chunks until none are left
+        void drain();
+    };
+
+    /**
+     * @brief Splits [begin, end) into chunks and runs fn(chunk, chunk_begin,
+     * chunk_end) for each, on the caller and helper tasks. Returns when every
+     * chunk has run; rethrows the first exception a chunk threw.
+     */
+    void run_chunks(size_t begin, size_t end, size_t grain,
+                    void (*run)(void*, size_t, size_t, size_t), void* fn);
+
+    // Every ChunkJob ever created (owned here), and the ones free for reuse
+    std::mutex m_job_mutex;
+    std::vector<std::unique_ptr<ChunkJob>> m_chunk_jobs;
+    std::vector<ChunkJob*> m_spare_jobs;
+
+    // A reset job from the pool (allocated only when none is spare)
+    ChunkJob* acquire_chunk_job();
+    // Drops one reference; the last one returns the job to the pool
+    void release_chunk_job(ChunkJob* job);
+
+    // Runs one task, reporting (not propagating) exceptions from post()ed work
+    static void run_task(Task& task);
+    Task* make_task_node(Task&& task);
+    void free_task_node(Task* node);
 
 public:
     /**
@@ -43,18 +273,189 @@ public:
      * @param command_queue_ref A reference to the CommandQueue containing the PlayerCommands.
      * @param worker_func The function containing the loop logic (e.g., worker_task from main.cpp).
      */
-    ThreadPool(size_t num_threads, CommandQueue& command_queue_ref, WorkerTaskFunc worker_func);
+    ThreadPool(size_t num_threads, CommandQueue& command_queue_ref, WorkerTaskFunc worker_func,
+               size_t num_task_threads = 0);
+
+    /**
+     * @brief Constructor for sharded dispatch: one worker per dispatcher shard.
+     * @param dispatcher The dispatcher whose shards the workers own.
+     * @param shard_worker_func The per-shard loop (e.g. calling ShardedDispatcher::run_shard).
+     * @param num_task_threads Extra workers for post()/submit() tasks.
+     */
+    ThreadPool(ShardedDispatcher& dispatcher, ShardWorkerFunc shard_worker_func,
+               size_t num_task_threads = 0);
+
+    /**
+     * @brief Constructor for a pure task pool (no command loop).
+     * @param num_task_threads Workers that run post()/submit() tasks.
+     */
+    explicit ThreadPool(size_t num_task_threads);
 
     // Destructor ensures that any running threads are joined.
     ~ThreadPool();
 
+    /**
+     * @brief Sets where start() pins the workers (command-loop workers first,
+     * then task workers) and the thread calling start() (the render thread).
+     */
+    void set_placement(PlacementConfig placement) { m_placement = std::move(placement); }
+
+    /**
+     * @brief Lets the pool park and unpark shard workers at runtime, keeping
+     * the fewest active workers that hold config.latency_target. Call before
+     * start(); only sharded mode can resize (other modes log a warning).
+     */
+    void enable_adaptive_sizing(AdaptiveSizingConfig config);
+
+    /**
+     * @brief Shard workers currently taking work (all of them without adaptive sizing).
+     */
+    size_t active_workers() const;
+
+    /**
+     * @brief The most recent resize decisions, oldest first.
+     */
+    std::vector<ResizeEvent> resize_log() const;
+
+    /**
+     * @brief Snapshot of every worker's counters since start() (empty before).
+     * Cheap enough to poll; use metrics_between() for the activity of an interval.
+     */
+    PoolMetrics metrics() const;
+
     /**
      * @brief Creates and launches all worker threads, starting the consumption process.
+     * Applies the placement, if any, and reports the resulting layout.
      */
     void start();
 
     /**
      * @brief Blocks until all worker threads complete their execution.
+     * Tasks already posted are run before the task workers exit.
      */
     void join();
+
+    /**
+     * @brief Runs step(participant, tick) for config.ticks ticks on
+     * config.participants threads (the caller is participant 0, the others
+     * are task workers), with every participant finishing tick N before any
+     * starts N+1. Ticks start every config.period. Blocks until the last
+     * tick; reports how long each participant waited at the barrier.
+     * Exceptions from step are logged. participants of 0 means
+     * max_lockstep_participants(); more than that is refused with a warning
+     * and empty stats. Do not call join() while it runs.
+     */
+    LockstepStats run_lockstep(LockstepConfig config, const std::function<void(size_t participant, uint64_t tick)>& step);
+
+    /**
+     * @brief Schedules a fire-and-forget task. Exceptions it throws are logged.
+     * With no task workers, or once join() has stopped the task queue, the
+     * task runs on the caller.
+     */
+    template <typename F>
+    void post(F&& callable) {
+        Task task(std::forward<F>(callable));
+        if (m_num_task_threads == 0) {
+            run_task(task);
+            return;
+        }
+        schedule(std::move(task));
+    }
+
+    /**
+     * @brief Schedules a task and returns a future for its result (or exception).
+     * With no task workers, or once the pool is joined, the task runs on the caller.
+     */
+    template <typename F>
+    auto submit(F&& callable) -> std::future<std::invoke_result_t<std::decay_t<F>&>> {
+        using Result = std::invoke_result_t<std::decay_t<F>&>;
+        std::packaged_task<Result()> job(std::forward<F>(callable));
+        auto future = job.get_future();
+        post(std::move(job));
+        return future;
+    }
+
+    /**
+     * @brief Runs one queued task on the calling thread, if there is one.
+     * Lets a command loop lend its idle time to the task queue.
+     * @return True if a task was run
+     */
+    bool run_pending_task();
+
+    /**
+     * @brief Runs queued tasks on the calling thread until done() is true.
+     * Use instead of blocking on a future from inside a task (fork-join),
+     * so the waiting worker keeps executing work rather than idling.
+     */
+    template <typename Pred>
+    void work_until(Pred done) {
+        while (!done()) {
+            if (!run_pending_task()) std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief Calls body(chunk_begin, chunk_end) over [begin, end) in parallel.
+     * The caller runs chunks too, and only ever its own chunks while waiting,
+     * so it is safe to call while holding a lock that other tasks might take.
+     * @param grain Items per chunk; 0 picks one from the range and worker count.
+     */
+    template <typename Body>
+    void parallel_for(size_t begin, size_t end, Body body, size_t grain = 0) {
+        run_chunks(begin, end, grain,
+            [](void* fn, size_t, size_t chunk_begin, size_t chunk_end) {
+                (*static_cast<Body*>(fn))(chunk_begin, chunk_end);
+            }, &body);
+    }
+
+    /**
+     * @brief Reduces [begin, end) in parallel: map(chunk_begin, chunk_end)
+     * gives each chunk's partial result, combined left to right with
+     * combine(a, b) starting from `identity`, so the result does not depend
+     * on scheduling.
+     */
+    template <typename T, typename Map, typename Combine>
+    T parallel_reduce(size_t begin, size_t end, T identity, Map map, Combine combine, size_t grain = 0) {
+        // Wrapped so that T = bool does not become a packed std::vector<bool>,
+        // whose elements cannot be written from different threads
+        struct Partial {
+            T value;
+        };
+        struct Reduction {
+            Map& map;
+            std::pmr::vector<Partial> partials;
+        };
+        // Partials are scratch on the calling thread's arena: no heap allocation per call
+        ArenaScope scope;
+        size_t chunk_size = grain_for(end > begin ? end - begin : 0, grain);
+        size_t chunks = end > begin ? (end - begin + chunk_size - 1) / chunk_size : 0;
+        Reduction reduction{map, std::pmr::vector<Partial>(chunks, Partial{identity}, &scope.arena())};
+        run_chunks(begin, end, chunk_size,
+            [](void* fn, size_t chunk, size_t chunk_begin, size_t chunk_end) {
+                auto& r = *static_cast<Reduction*>(fn);
+                r.partials[chunk].value = r.map(chunk_begin, chunk_end);
+            }, &reduction);
+
+        T result = std::move(identity);
+        for (auto& partial : reduction.partials) result = combine(std::move(result), std::move(partial.value));
+        return result;
+    }
+
+    /**
+     * @brief Grain parallel_for/parallel_reduce use for `count` items (grain 0 = automatic).
+     */
+    size_t grain_for(size_t count, size_t grain) const {
+        if (grain > 0) return grain;
+        size_t target_chunks = (m_num_task_threads + 1) * CHUNKS_PER_WORKER;
+        return std::max(MIN_GRAIN, (count + target_chunks - 1) / target_chunks);
+    }
+
+    size_t task_thread_count() const { return m_num_task_threads; }
+
+    /**
+     * @brief Most participants run_lockstep can run from the calling thread:
+     * the task workers plus the caller (the caller's own worker counts once if
+     * it is a task worker). 1 once the task queue is stopped.
+     */
+    size_t max_lockstep_participants() const;
 };
\ No newline at end of file
@@ -0,0 +1,375 @@
+/*
+TickExecutor.h
+C++20 coroutines for timed game logic, resumed on the ThreadPool.
+
+Instead of an accumulator per timer, polled from update_physics every
+tick, a behaviour is written as a GameTask coroutine:
+
+    GameTask spawner(TickExecutor& ticks) {
+        for (;;) {
+            co_await ticks.sleep_for(108); // 1.8 s at 60 Hz
+            spawn_pipe();
+        }
+    }
+    ticks.spawn(spawner(ticks));
+
+A suspended coroutine costs nothing until it is due: sleepers sit in a
+min-heap keyed by their wake-up tick, and tick() only touches the ones
+that are due, posting each resume to the pool. `co_await command_from(queue)`
+suspends until an item is pushed to an AwaitableQueue, which resumes the
+waiter on the pool with the item.
+
+Coroutines resume on whichever task worker picks them up, so they must
+take the same locks as any other pool task. Destroying the executor
+destroys every coroutine it still owns, sleeping or waiting on a queue.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+class TickExecutor;
+
+// Somewhere coroutines park outside the executor (an AwaitableQueue), so the
+// executor can reclaim them when it is destroyed
+class CoroutineWaitList {
+public:
+    // Removes the waiters owned by `executor` and returns their handles
+    virtual std::vector<std::coroutine_handle<>> take_waiters(const TickExecutor& executor) = 0;
+
+protected:
+    ~CoroutineWaitList() = default;
+};
+
+/**
+ * A fire-and-forget coroutine run by a TickExecutor. It starts suspended,
+ * runs once passed to TickExecutor::spawn(), and frees itself when it
+ * finishes. Exceptions that escape it are logged.
+ */
+class GameTask {
+public:
+    struct promise_type {
+        TickExecutor* executor = nullptr;
+
+        GameTask get_return_object() {
+            return GameTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {
+            try {
+                throw;
+            } catch (const std::exception& e) {
+                std::cerr << "[TickExecutor] Warning: coroutine threw: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "[TickExecutor] Warning: coroutine threw an unknown exception" << std::endl;
+            }
+        }
+        ~promise_type();
+    };
+
+    GameTask(GameTask&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    GameTask& operator=(GameTask&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    GameTask(const GameTask&) = delete;
+    GameTask& operator=(const GameTask&) = delete;
+
+    // A task that was never spawned is destroyed without running
+    ~GameTask() {
+        if (m_handle) m_handle.destroy();
+    }
+
+private:
+    friend class TickExecutor;
+    explicit GameTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+
+class TickExecutor {
+private:
+    struct Sleeper {
+        uint64_t due;
+        uint64_t order; // FIFO among sleepers due on the same tick
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Sleeper& other) const {
+            return due != other.due ? due > other.due : order > other.order;
+        }
+    };
+
+    ThreadPool& m_pool;
+    mutable std::mutex m_mutex;
+    uint64_t m_tick = 0;
+    uint64_t m_order = 0;
+    std::priority_queue<Sleeper, std::vector<Sleeper>, std::greater<Sleeper>> m_sleepers;
+    std::vector<CoroutineWaitList*> m_wait_lists; // queues our coroutines have waited on
+    std::atomic<size_t> m_live{0};
+
+    friend struct GameTask::promise_type;
+
+public:
+    struct SleepAwaiter {
+        TickExecutor& executor;
+        uint64_t ticks;
+
+        bool await_ready() const noexcept { return ticks == 0; }
+        void await_suspend(std::coroutine_handle<> handle) { executor.sleep(handle, ticks); }
+        void await_resume() const noexcept {}
+    };
+
+    explicit TickExecutor(ThreadPool& pool) : m_pool(pool) {}
+
+    TickExecutor(const TickExecutor&) = delete;
+    TickExecutor& operator=(const TickExecutor&) = delete;
+
+    /**
+     * @brief Destroys coroutines still sleeping or waiting on a queue. Destroy
+     * the executor only after the pool is joined, so no coroutine is running.
+     */
+    ~TickExecutor() {
+        std::vector<std::coroutine_handle<>> suspended;
+        std::vector<CoroutineWaitList*> wait_lists;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (!m_sleepers.empty()) {
+                suspended.push_back(m_sleepers.top().handle);
+                m_sleepers.pop();
+            }
+            wait_lists.swap(m_wait_lists);
+        }
+        // Outside m_mutex: a queue calls watch()/forget() under its own lock
+        for (CoroutineWaitList* list : wait_lists) {
+            for (auto handle : list->take_waiters(*this)) suspended.push_back(handle);
+        }
+        for (auto handle : suspended) handle.destroy();
+    }
+
+    /**
+     * @brief Starts a coroutine on the pool; the executor owns it from here on.
+     */
+    void spawn(GameTask task) {
+        auto handle = std::exchange(task.m_handle, {});
+        handle.promise().executor = this;
+        m_live.fetch_add(1, std::memory_order_relaxed);
+        resume(handle);
+    }
+
+    /**
+     * @brief Advances game time by one tick and resumes every coroutine due.
+     * Call once per fixed step, without holding locks the coroutines take.
+     */
+    void tick() {
+        ArenaScope scope;
+        std::pmr::vector<std::coroutine_handle<>> due(&scope.arena());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_tick;
+            while (!m_sleepers.empty() && m_sleepers.top().due <= m_tick) {
+                due.push_back(m_sleepers.top().handle);
+                m_sleepers.pop();
+            }
+        }
+        for (auto handle : due) resume(handle);
+    }
+
+    // co_await sleep_for(n): resume n ticks from now (0 does not suspend)
+    SleepAwaiter sleep_for(uint64_t ticks) { return SleepAwaiter{*this, ticks}; }
+
+    // co_await next_tick(): resume on the next tick()
+    SleepAwaiter next_tick() { return SleepAwaiter{*this, 1}; }
+
+    // Schedules a suspended coroutine to continue on the pool
+    void resume(std::coroutine_handle<> handle) {
+        m_pool.post([handle] { handle.resume(); });
+    }
+
+    // Registers a suspended coroutine to resume `ticks` ticks from now
+    void sleep(std::coroutine_handle<> handle, uint64_t ticks) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sleepers.push(Sleeper{m_tick + ticks, m_order++, handle});
+    }
+
+    // Called by a queue the first time one of our coroutines waits on it
+    void watch(CoroutineWaitList* list) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::find(m_wait_lists.begin(), m_wait_lists.end(), list) == m_wait_lists.end()) {
+            m_wait_lists.push_back(list);
+        }
+    }
+
+    // Called by a queue being destroyed
+    void forget(CoroutineWaitList* list) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wait_lists.erase(std::remove(m_wait_lists.begin(), m_wait_lists.end(), list), m_wait_lists.end());
+    }
+
+    uint64_t now() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tick;
+    }
+
+    // Coroutines spawned and not yet finished (running, sleeping or waiting on a queue)
+    size_t live() const { return m_live.load(std::memory_order_relaxed); }
+
+    size_t sleeping() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sleepers.size();
+    }
+};
+
+inline GameTask::promise_type::~promise_type() {
+    if (executor) executor->m_live.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+/**
+ * An unbounded queue a GameTask can wait on with `co_await command_from(queue)`.
+ * push() hands the item straight to the oldest waiting coroutine, if any,
+ * and resumes it on its executor; otherwise the item is buffered.
+ * close() wakes every waiter with std::nullopt. A coroutine still waiting
+ * when its executor is destroyed is destroyed with it.
+ */
+template <typename T>
+class AwaitableQueue : public CoroutineWaitList {
+private:
+    struct Waiter {
+        std::coroutine_handle<GameTask::promise_type> handle;
+        std::optional<T>* slot;
+    };
+
+    std::mutex m_mutex;
+    std::deque<T> m_items;
+    std::deque<Waiter> m_waiters;
+    std::vector<TickExecutor*> m_executors; // executors watching this queue
+    bool m_closed = false;
+
+public:
+    struct Awaiter {
+        AwaitableQueue& queue;
+        std::optional<T> item;
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            if (!queue.m_items.empty()) {
+                item = std::move(queue.m_items.front());
+                queue.m_items.pop_front();
+                return true;
+            }
+            return queue.m_closed;
+        }
+
+        bool await_suspend(std::coroutine_handle<GameTask::promise_type> handle) {
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            // Re-check: an item may have arrived since await_ready
+            if (!queue.m_items.empty()) {
+                item = std::move(queue.m_items.front());
+                queue.m_items.pop_front();
+                return false;
+            }
+            if (queue.m_closed) return false;
+            TickExecutor* executor = handle.promise().executor;
+            auto& executors = queue.m_executors;
+            if (std::find(executors.begin(), executors.end(), executor) == executors.end()) {
+                executors.push_back(executor);
+                executor->watch(&queue);
+            }
+            queue.m_waiters.push_back(Waiter{handle, &item});
+            return true;
+        }
+
+        // The item, or std::nullopt once the queue is closed and empty
+        std::optional<T> await_resume() { return std::move(item); }
+    };
+
+    AwaitableQueue() = default;
+    AwaitableQueue(const AwaitableQueue&) = delete;
+    AwaitableQueue& operator=(const AwaitableQueue&) = delete;
+
+    ~AwaitableQueue() {
+        close();
+        std::vector<TickExecutor*> executors;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            executors.swap(m_executors);
+        }
+        for (TickExecutor* executor : executors) executor->forget(this);
+    }
+
+    std::vector<std::coroutine_handle<>> take_waiters(const TickExecutor& executor) override {
+        std::vector<std::coroutine_handle<>> taken;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::erase(m_executors, &executor);
+        std::erase_if(m_waiters, [&](const Waiter& waiter) {
+            if (waiter.handle.promise().executor != &executor) return false;
+            taken.push_back(waiter.handle);
+            return true;
+        });
+        return taken;
+    }
+
+    /**
+     * @brief Adds an item, or gives it to a waiting coroutine.
+     * @return False if the queue is closed
+     */
+    bool push(T item) {
+        Waiter waiter;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed) return false;
+            if (m_waiters.empty()) {
+                m_items.push_back(std::move(item));
+                return true;
+            }
+            waiter = m_waiters.front();
+            m_waiters.pop_front();
+            *waiter.slot = std::move(item);
+        }
+        waiter.handle.promise().executor->resume(waiter.handle);
+        return true;
+    }
+
+    /**
+     * @brief Wakes every waiting coroutine with std::nullopt; later pushes fail.
+     */
+    void close() {
+        std::deque<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            waiters.swap(m_waiters);
+        }
+        for (auto& waiter : waiters) waiter.handle.promise().executor->resume(waiter.handle);
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+};
+
+/**
+ * @brief co_await command_from(queue): the next item, or std::nullopt once the queue is closed.
+ */
+template <typename T>
+typename AwaitableQueue<T>::Awaiter command_from(AwaitableQueue<T>& queue) {
+    return typename AwaitableQueue<T>::Awaiter{queue, std::nullopt};
+}
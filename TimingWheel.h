@@ -0,0 +1,155 @@
+/*
+TimingWheel.h
+Hierarchical timing wheel (Varghese & Lauck), as used by the Linux kernel
+timer base.
+
+Four levels of 256 slots cover 2^32 ticks. A timer goes into the level
+whose span covers its distance from "now", in the slot picked by the
+matching bits of its expiry tick. Level 0 slots fire; when level 0 wraps,
+the next slot of level 1 is cascaded down, and so on upwards. Timers are
+intrusive doubly linked nodes, so schedule and cancel are O(1) and never
+allocate, and advancing costs O(1) per tick plus each timer's (at most
+four) cascades.
+
+Not thread-safe: the owner serializes access.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A timer node, embedded in whatever is being scheduled. Must stay at the
+ * same address while it is scheduled.
+ */
+struct WheelTimer {
+    uint64_t expires = 0;
+    WheelTimer* prev = nullptr;
+    WheelTimer* next = nullptr;
+
+    bool scheduled() const { return next != nullptr; }
+};
+
+class TimingWheel {
+private:
+    static constexpr unsigned LEVEL_BITS = 8;
+    static constexpr size_t SLOTS = size_t{1} << LEVEL_BITS;
+    static constexpr size_t LEVELS = 4;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint64_t MAX_DELTA = (uint64_t{1} << (LEVEL_BITS * LEVELS)) - 1;
+
+    // Each slot is a circular list around a sentinel node
+    std::array<std::array<WheelTimer, SLOTS>, LEVELS> m_slots;
+    uint64_t m_now = 0;
+    size_t m_count = 0;
+
+    static void link(WheelTimer& head, WheelTimer& timer) {
+        timer.prev = head.prev;
+        timer.next = &head;
+        head.prev->next = &timer;
+        head.prev = &timer;
+    }
+
+    static void unlink(WheelTimer& timer) {
+        timer.prev->next = timer.next;
+        timer.next->prev = timer.prev;
+        timer.prev = nullptr;
+        timer.next = nullptr;
+    }
+
+    // expires >= m_now; a timer for m_now itself lands in the slot about to fire
+    WheelTimer& slot_for(uint64_t expires) {
+        uint64_t delta = expires - m_now;
+        if (delta > MAX_DELTA) {
+            // Beyond the top level: park at its far end, re-cascaded from there
+            delta = MAX_DELTA;
+        }
+        uint64_t target = m_now + delta;
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >= (uint64_t{1} << (LEVEL_BITS * (level + 1)))) ++level;
+        return m_slots[level][(target >> (LEVEL_BITS * level)) & SLOT_MASK];
+    }
+
+    // Moves every timer of one slot down to the level its expiry now falls in
+    void cascade(size_t level, size_t index) {
+        WheelTimer& head = m_slots[level][index];
+        WheelTimer list;
+        if (head.next == &head) return;
+        // Take the whole list first: re-inserting may target this very slot
+        list.next = head.next;
+        list.prev = head.prev;
+        list.next->prev = &list;
+        list.prev->next = &list;
+        head.next = head.prev = &head;
+        while (list.next != &list) {
+            WheelTimer& timer = *list.next;
+            unlink(timer);
+            link(slot_for(timer.expires), timer);
+        }
+    }
+
+public:
+    explicit TimingWheel(uint64_t now = 0) : m_now(now) {
+        for (auto& level : m_slots) {
+            for (auto& head : level) head.prev = head.next = &head;
+        }
+    }
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    /**
+     * @brief Schedules (or reschedules) a timer for tick `expires`.
+     * A tick at or before now() fires on the next advance.
+     */
+    void schedule(WheelTimer& timer, uint64_t expires) {
+        if (timer.scheduled()) cancel(timer);
+        // Already due: fire on the next tick (the current one may be firing)
+        timer.expires = expires > m_now ? expires : m_now + 1;
+        link(slot_for(timer.expires), timer);
+        ++m_count;
+    }
+
+    /**
+     * @brief Removes a scheduled timer; does nothing if it is not scheduled.
+     */
+    void cancel(WheelTimer& timer) {
+        if (!timer.scheduled()) return;
+        unlink(timer);
+        --m_count;
+    }
+
+    /**
+     * @brief Moves time forward to tick `to`, calling on_expired(timer) for
+     * every timer that expires on the way, in tick order. The callback may
+     * schedule timers again (including the one it was given).
+     */
+    template <typename OnExpired>
+    void advance(uint64_t to, OnExpired on_expired) {
+        while (m_now < to) {
+            if (m_count == 0) {
+                m_now = to;
+                return;
+            }
+            ++m_now;
+            // Level 0 wrapped: pull the next slot of level 1 down, and so on up
+            for (size_t level = 1; level < LEVELS; ++level) {
+                if (((m_now >> (LEVEL_BITS * (level - 1))) & SLOT_MASK) != 0) break;
+                cascade(level, (m_now >> (LEVEL_BITS * level)) & SLOT_MASK);
+            }
+
+            WheelTimer& head = m_slots[0][m_now & SLOT_MASK];
+            while (head.next != &head) {
+                WheelTimer& timer = *head.next;
+                unlink(timer);
+                --m_count;
+                on_expired(timer);
+            }
+        }
+    }
+
+    uint64_t now() const { return m_now; }
+    size_t size() const { return m_count; }
+};
@@ -0,0 +1,131 @@
+/*
+WorkStealingDeque.h
+Chase-Lev work-stealing deque (the C11 formulation by Lê et al., 2013).
+
+The owning worker pushes and pops at the bottom (LIFO: the task it just
+spawned is hot in its cache), while idle workers steal from the top
+(FIFO: the oldest task, typically the largest piece of remaining work).
+The owner's push/pop are plain loads and stores except when the deque
+is down to its last item; a steal costs one CAS on `top`.
+
+Elements are pointers, so every slot can be read and written atomically.
+The ring grows when full; retired rings are kept until the deque is
+destroyed, since a concurrent thief may still be reading one.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "QueueCommon.h"
+
+template <typename T>
+class WorkStealingDeque {
+private:
+    struct Ring {
+        const int64_t capacity;
+        const int64_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        explicit Ring(int64_t cap)
+            : capacity(cap), mask(cap - 1), slots(new std::atomic<T*>[static_cast<size_t>(cap)]) {}
+
+        T* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T* item) { slots[i & mask].store(item, std::memory_order_relaxed); }
+
+        Ring* grow(int64_t bottom, int64_t top) const {
+            Ring* bigger = new Ring(capacity * 2);
+            for (int64_t i = top; i < bottom; ++i) bigger->put(i, get(i));
+            return bigger;
+        }
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_top{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_bottom{0};
+    std::atomic<Ring*> m_ring;
+    std::vector<std::unique_ptr<Ring>> m_rings; // owner-only; every ring ever allocated
+
+public:
+    /**
+     * @brief Constructs the deque.
+     * @param capacity Initial ring size, rounded up to a power of two; grows on demand.
+     */
+    explicit WorkStealingDeque(size_t capacity = 256) {
+        m_rings.emplace_back(new Ring(static_cast<int64_t>(round_up_pow2(capacity))));
+        m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /**
+     * @brief Owner only: pushes an item at the bottom.
+     */
+    void push(T* item) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Ring* ring = m_ring.load(std::memory_order_relaxed);
+        if (b - t > ring->capacity - 1) {
+            m_rings.emplace_back(ring->grow(b, t));
+            ring = m_rings.back().get();
+            m_ring.store(ring, std::memory_order_release);
+        }
+        ring->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Owner only: pops the most recently pushed item.
+     * @return nullptr if the deque is empty (or a thief took the last item)
+     */
+    T* pop() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Ring* ring = m_ring.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            m_bottom.store(b + 1, std::memory_order_relaxed); // was empty
+            return nullptr;
+        }
+        T* item = ring->get(b);
+        if (t == b) {
+            // Last item: race any thief for it
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /**
+     * @brief Any thread: takes the oldest item from the top.
+     * @return nullptr if the deque was empty or another thread won the race
+     */
+    T* steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+
+        Ring* ring = m_ring.load(std::memory_order_acquire);
+        T* item = ring->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate number of items (exact only when called by the owner with no thieves)
+    size_t size() const {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+};
@@ -0,0 +1,914 @@
+/*
+benchmarks.cpp
+Standalone micro-benchmarks for the command queues (no SFML required).
+
+Build:  g++ -std=c++20 -O2 benchmarks.cpp threadPool.cpp CpuAffinity.cpp -o benchmarks -pthread
+        (add -lrt on older glibc for shm_open)
+Run:    ./benchmarks
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <array>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <random>
+#include <variant>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "SafeQueue.h"
+#include "RingQueue.h"
+#include "SpscQueue.h"
+#include "ShmQueue.h"
+#include "MulticastRing.h"
+#include "ThreadPool.h"
+#include "PlayerCommand.h"
+#include "RoomScheduler.h"
+#include "ShardedDispatcher.h"
+#include "TickExecutor.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+// Total commands moved through the queue per throughput run
+const size_t THROUGHPUT_ITEMS = 1000000;
+// Commands sampled per latency run, and the gap between them
+const size_t LATENCY_SAMPLES = 100000;
+const auto LATENCY_PACING = std::chrono::microseconds(5);
+// Commands per dispatch run (repeated DISPATCH_ROUNDS times)
+const size_t DISPATCH_COMMANDS = 4096;
+const size_t DISPATCH_ROUNDS = 2000;
+// Work-stealing pool workloads: fork-join range size and leaf size, tasks per flood
+const size_t FORK_JOIN_RANGE = size_t{1} << 24;
+const size_t FORK_JOIN_LEAF = 4096;
+const size_t FLOOD_TASKS = 500000;
+// Room scheduler run: room counts, tick period and run time per count
+const size_t ROOM_COUNTS[] = {1000, 10000, 50000};
+const auto ROOM_PERIOD = std::chrono::microseconds(16667);
+const auto ROOM_RUN_TIME = std::chrono::seconds(2);
+
+// Multicast stream: commands published once and read by all three consumers
+const size_t MULTICAST_ITEMS = 2000000;
+const size_t MULTICAST_CAPACITY = 4096;
+
+// Lockstep rooms: 240 Hz for one second, evenly loaded and with one heavy group
+const size_t LOCKSTEP_ROOMS = 10000;
+const uint64_t LOCKSTEP_TICKS = 240;
+const auto LOCKSTEP_PERIOD = std::chrono::microseconds(4167);
+
+/**
+ * @brief Moves THROUGHPUT_ITEMS commands through the queue with the given
+ * number of producers and consumers.
+ * @return Throughput in millions of commands per second
+ */
+template <typename Queue>
+double run_throughput(size_t producers, size_t consumers) {
+    Queue queue;
+    std::atomic<size_t> consumed{0};
+    std::vector<std::thread> threads;
+    const size_t per_producer = THROUGHPUT_ITEMS / producers;
+
+    auto start = bench_clock::now();
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&queue, &consumed] {
+            PlayerCommand cmd;
+            size_t local = 0;
+            while (queue.pop(cmd)) ++local;
+            consumed.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+
+    std::vector<std::thread> producer_threads;
+    for (size_t p = 0; p < producers; ++p) {
+        producer_threads.emplace_back([&queue, per_producer, p] {
+            for (size_t i = 0; i < per_producer; ++i) {
+                PlayerCommand cmd;
+                cmd.player_id = static_cast<int>(p);
+                cmd.action = Flap{};
+                queue.push(std::move(cmd));
+            }
+        });
+    }
+    for (auto& t : producer_threads) t.join();
+    queue.stop();
+    for (auto& t : threads) t.join();
+    auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    return static_cast<double>(consumed.load()) / elapsed / 1e6;
+}
+
+void throughput_comparison() {
+    std::cout << "Queue throughput (Mcmd/s), N producers x N consumers, "
+              << THROUGHPUT_ITEMS << " commands\n";
+    std::cout << std::setw(6) << "N" << std::setw(14) << "SafeQueue" << std::setw(14) << "RingQueue" << "\n";
+    for (size_t n : {1, 2, 4, 8}) {
+        double safe = run_throughput<SafeQueue<PlayerCommand>>(n, n);
+        double ring = run_throughput<RingQueue<PlayerCommand>>(n, n);
+        std::cout << std::setw(6) << n << std::fixed << std::setprecision(2)
+                  << std::setw(14) << safe << std::setw(14) << ring << "\n";
+    }
+}
+
+/**
+ * @brief One producer, one consumer: measures enqueue-to-dequeue latency the
+ * same way GameState::process_command does (now - command.timestamp).
+ * The producer is paced so we measure hand-off latency, not queue build-up.
+ */
+template <typename Queue, typename... Args>
+void run_latency(const char* name, Args&&... queue_args) {
+    Queue queue(std::forward<Args>(queue_args)...);
+    std::vector<long long> samples;
+    samples.reserve(LATENCY_SAMPLES);
+
+    std::thread consumer([&queue, &samples] {
+        PlayerCommand cmd;
+        while (queue.pop(cmd)) {
+            auto now = std::chrono::high_resolution_clock::now();
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - cmd.timestamp).count());
+        }
+    });
+
+    for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+        auto next = bench_clock::now() + LATENCY_PACING;
+        PlayerCommand cmd;
+        cmd.action = Flap{};
+        cmd.timestamp = std::chrono::high_resolution_clock::now();
+        queue.push(std::move(cmd));
+        while (bench_clock::now() < next) {} // busy-wait pacing, no sleep jitter
+    }
+    queue.stop();
+    consumer.join();
+
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&samples](double p) { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+    std::cout << std::setw(12) << name << std::setw(10) << pct(0.50) << std::setw(10) << pct(0.99)
+              << std::setw(12) << samples.back() << "\n";
+}
+
+/**
+ * @brief Same measurement as run_latency, but across processes: a forked
+ * child produces into a ShmQueue and this process consumes.
+ */
+void run_shm_latency() {
+    const std::string name = "/flappy_bench_" + std::to_string(::getpid());
+    ShmQueue<PlayerCommand> queue(name, ShmRole::Consumer);
+
+    pid_t child = ::fork();
+    if (child == 0) {
+        ShmQueue<PlayerCommand> producer(name, ShmRole::Producer);
+        for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+            auto next = bench_clock::now() + LATENCY_PACING;
+            PlayerCommand cmd;
+            cmd.action = Flap{};
+            cmd.timestamp = std::chrono::high_resolution_clock::now();
+            producer.push(cmd);
+            while (bench_clock::now() < next) {}
+        }
+        producer.stop();
+        ::_exit(0);
+    }
+
+    std::vector<long long> samples;
+    samples.reserve(LATENCY_SAMPLES);
+    PlayerCommand cmd;
+    while (queue.pop(cmd)) {
+        auto now = std::chrono::high_resolution_clock::now();
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - cmd.timestamp).count());
+    }
+    ::waitpid(child, nullptr, 0);
+    if (samples.empty()) return;
+
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&samples](double p) { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+    std::cout << std::setw(12) << "ShmQueue" << std::setw(10) << pct(0.50) << std::setw(10) << pct(0.99)
+              << std::setw(12) << samples.back() << "  (cross-process)\n";
+}
+
+void latency_comparison() {
+    std::cout << "Enqueue-to-dequeue latency (ns), 1 producer x 1 consumer, "
+              << LATENCY_SAMPLES << " commands\n";
+    std::cout << std::setw(12) << "queue" << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(12) << "max" << "\n";
+    run_latency<SafeQueue<PlayerCommand>>("SafeQueue");
+    QueueConfig spin_config;
+    spin_config.wait = WaitStrategy::SpinThenPark;
+    run_latency<SafeQueue<PlayerCommand>>("Safe/spin", spin_config);
+    run_latency<RingQueue<PlayerCommand>>("RingQueue");
+    run_latency<SpscQueue<PlayerCommand>>("SpscQueue");
+    run_shm_latency();
+}
+
+// Minimal stand-in for the GameState fields the command handlers touch
+struct DispatchState {
+    float y_vel = 0.0f;
+    bool alive = true;
+    bool paused = false;
+    int joins = 0;
+
+    void apply(const NoAction&) {}
+    void apply(const Flap&) { if (alive && !paused) y_vel = 15.0f; }
+    void apply(const Join&) { ++joins; }
+    void apply(const Leave&) { alive = !alive; } // keep the state changing
+    void apply(const Pause& pause) { paused = pause.paused; }
+    void apply(const Ability&) { if (alive && !paused) y_vel = 0.0f; }
+};
+
+// The pre-variant command: a kind enum and no payload
+struct EnumCommand {
+    int player_id = 0;
+    ActionType type = ActionType::NONE;
+};
+
+template <typename Commands, typename Apply>
+double time_dispatch(const Commands& commands, Apply apply) {
+    auto start = bench_clock::now();
+    for (size_t round = 0; round < DISPATCH_ROUNDS; ++round) {
+        for (const auto& command : commands) apply(command);
+    }
+    double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+    return ns / static_cast<double>(DISPATCH_ROUNDS * commands.size());
+}
+
+/**
+ * @brief Per-command dispatch cost: the old `type == FLAP` check, an enum
+ * switch over every kind, and std::visit over CommandAction, all applied to
+ * the same random mix of actions.
+ */
+void dispatch_comparison() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> kind(0, static_cast<int>(std::variant_size_v<CommandAction>) - 1);
+    std::vector<PlayerCommand> commands(DISPATCH_COMMANDS);
+    std::vector<EnumCommand> enum_commands(DISPATCH_COMMANDS);
+    for (size_t i = 0; i < DISPATCH_COMMANDS; ++i) {
+        switch (static_cast<ActionType>(kind(rng))) {
+        case ActionType::NONE:    commands[i].action = NoAction{}; break;
+        case ActionType::FLAP:    commands[i].action = Flap{}; break;
+        case ActionType::JOIN:    commands[i].action = Join{}; break;
+        case ActionType::LEAVE:   commands[i].action = Leave{}; break;
+        case ActionType::PAUSE:   commands[i].action = Pause{(i & 1) != 0}; break;
+        case ActionType::ABILITY: commands[i].action = Ability{}; break;
+        }
+        enum_commands[i].type = commands[i].type();
+    }
+
+    DispatchState state;
+    double flap_check = time_dispatch(enum_commands, [&state](const EnumCommand& command) {
+        if (command.type == ActionType::FLAP) state.apply(Flap{});
+    });
+    double enum_switch = time_dispatch(enum_commands, [&state](const EnumCommand& command) {
+        switch (command.type) {
+        case ActionType::NONE:    state.apply(NoAction{}); break;
+        case ActionType::FLAP:    state.apply(Flap{}); break;
+        case ActionType::JOIN:    state.apply(Join{}); break;
+        case ActionType::LEAVE:   state.apply(Leave{}); break;
+        case ActionType::PAUSE:   state.apply(Pause{}); break;
+        case ActionType::ABILITY: state.apply(Ability{}); break;
+        }
+    });
+    double visit = time_dispatch(commands, [&state](const PlayerCommand& command) {
+        std::visit([&state](const auto& action) { state.apply(action); }, command.action);
+    });
+
+    std::cout << "Command dispatch cost (ns/command), " << DISPATCH_COMMANDS << " mixed commands x "
+              << DISPATCH_ROUNDS << " rounds, sizeof(PlayerCommand) = " << sizeof(PlayerCommand) << "\n"
+              << "  enum FLAP check:   " << flap_check << "\n"
+              << "  enum switch:       " << enum_switch << "\n"
+              << "  std::visit:        " << visit << "\n"
+              << "  (state: " << state.y_vel << ", " << state.joins << ")\n";
+}
+
+/**
+ * @brief Runs a contended SafeQueue workload and prints its built-in
+ * instrumentation, separating time spent queued from time waiting on the lock.
+ */
+void instrumentation_report() {
+    QueueConfig config;
+    config.instrument = true;
+    SafeQueue<PlayerCommand> queue(config);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < 4; ++c) {
+        threads.emplace_back([&queue] { PlayerCommand cmd; while (queue.pop(cmd)) {} });
+    }
+    auto before = queue.stats();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&queue] {
+            for (size_t i = 0; i < THROUGHPUT_ITEMS / 4; ++i) queue.push(PlayerCommand{});
+        });
+    }
+    for (auto& t : producers) t.join();
+    queue.stop();
+    for (auto& t : threads) t.join();
+    auto after = queue.stats();
+    auto rates = queue_rates(before, after);
+
+    std::cout << "SafeQueue instrumentation, 4 producers x 4 consumers\n"
+              << "  peak depth:        " << after.peak_depth << "\n"
+              << "  push rate:         " << rates.pushes_per_sec / 1e6 << " M/s\n"
+              << "  pop rate:          " << rates.pops_per_sec / 1e6 << " M/s\n"
+              << "  time in queue p50: <" << histogram_percentile_ns(after.queue_wait, 0.50) << " ns\n"
+              << "  time in queue p99: <" << histogram_percentile_ns(after.queue_wait, 0.99) << " ns\n"
+              << "  uncontended locks: " << after.uncontended_locks << "\n"
+              << "  lock wait p99:     <" << histogram_percentile_ns(after.lock_wait, 0.99) << " ns\n";
+}
+
+/**
+ * @brief Checks that ShardedDispatcher releases every command its shard
+ * queues throw away: stale FLAPs (DropStale queues), repeats from one
+ * player (CoalescingQueue merges) and fresh ones must all leave every
+ * shard with nothing in flight once the shards are drained.
+ * @return True if no shard was left with commands in flight
+ */
+bool dispatcher_accounting_check() {
+    ShardedDispatcher dispatcher(2);
+    auto command_at = [](int player, std::chrono::high_resolution_clock::time_point at) {
+        PlayerCommand command;
+        command.player_id = player;
+        command.action = Flap{};
+        command.timestamp = at;
+        return command;
+    };
+    const auto now = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 10; ++i) dispatcher.push(command_at(i, now - std::chrono::seconds(1)));
+    for (int i = 0; i < 10; ++i) dispatcher.push(command_at(42, now));
+    for (int i = 0; i < 10; ++i) dispatcher.push(command_at(i, now));
+    dispatcher.stop();
+
+    size_t applied = 0;
+    for (size_t shard = 0; shard < dispatcher.shard_count(); ++shard) {
+        // Stopped, so each shard loop drains its queue and returns
+        dispatcher.run_shard(shard, [&applied](std::span<const PlayerCommand> batch) { applied += batch.size(); },
+                             [] {}, std::chrono::milliseconds(1000));
+    }
+
+    size_t in_flight = 0;
+    uint64_t discarded = 0;
+    for (size_t shard = 0; shard < dispatcher.shard_count(); ++shard) {
+        in_flight += dispatcher.in_flight(shard);
+        discarded += dispatcher.discarded(shard);
+    }
+    std::cout << "ShardedDispatcher accounting, 30 commands (10 stale, 10 repeats)\n"
+              << "  applied " << applied << ", discarded " << discarded << ", in flight " << in_flight
+              << (in_flight == 0 ? "  ok" : "  LEAKED") << "\n";
+    return in_flight == 0;
+}
+
+/**
+ * @brief Skewed traffic on two shards: an idle shard should take exactly one
+ * bucket off the busy one, then stop once traffic is even or has gone quiet.
+ */
+bool rebalance_check() {
+    auto flap = [](int player) {
+        PlayerCommand command;
+        command.player_id = player;
+        command.action = Flap{};
+        command.timestamp = std::chrono::high_resolution_clock::now();
+        return command;
+    };
+    auto drain = [](ShardedDispatcher& dispatcher) {
+        dispatcher.stop();
+        for (size_t shard = 0; shard < dispatcher.shard_count(); ++shard) {
+            dispatcher.run_shard(shard, [](std::span<const PlayerCommand>) {}, [] {},
+                                 std::chrono::milliseconds(1000));
+        }
+    };
+    // Just past ShardedDispatcher::REBALANCE_WINDOW, so rebalance() measures a fresh window
+    auto next_window = [] { std::this_thread::sleep_for(std::chrono::milliseconds(110)); };
+
+    // Skewed: two hot players on shard 0, one quiet player on shard 1
+    ShardedDispatcher skewed(2);
+    std::vector<int> on_shard[2];
+    for (int player = 0; on_shard[0].size() < 2 || on_shard[1].empty(); ++player) {
+        const size_t before = skewed.in_flight(0);
+        skewed.push(flap(player));
+        on_shard[skewed.in_flight(0) > before ? 0 : 1].push_back(player);
+    }
+    for (int i = 0; i < 100; ++i) {
+        skewed.push(flap(on_shard[0][0]));
+        skewed.push(flap(on_shard[0][1]));
+    }
+    drain(skewed);
+    next_window();
+    const bool moved = skewed.rebalance(1);
+    next_window();
+    const bool moved_again = skewed.rebalance(1); // no traffic since the move
+
+    // Even: ten commands each for eight players per shard
+    ShardedDispatcher even(2);
+    size_t per_shard[2] = {0, 0};
+    for (int player = 0; per_shard[0] < 8 || per_shard[1] < 8; ++player) {
+        const size_t before = even.in_flight(0);
+        even.push(flap(player));
+        const size_t shard = even.in_flight(0) > before ? 0 : 1;
+        for (int i = 1; i < 10 && per_shard[shard] < 8; ++i) even.push(flap(player));
+        ++per_shard[shard];
+    }
+    drain(even);
+    next_window();
+    const bool moved_even = even.rebalance(1);
+
+    const bool ok = moved && !moved_again && !moved_even && skewed.rebalanced() == 1 && even.rebalanced() == 0;
+    std::cout << "ShardedDispatcher rebalance\n"
+              << "  skewed: moved " << skewed.rebalanced() << " bucket(s), quiet window moved "
+              << (moved_again ? "again" : "none") << "; even: moved " << even.rebalanced()
+              << (ok ? "  ok" : "  UNEXPECTED") << "\n";
+    return ok;
+}
+
+/**
+ * @brief One command stream, three readers: the simulation applies every
+ * command, a journal writer serializes it, and a metrics reader counts
+ * actions only after the journal has released them. Compared with giving
+ * each reader its own RingQueue copy of the stream.
+ */
+void multicast_report() {
+    std::vector<PlayerCommand> commands(1024);
+    for (size_t i = 0; i < commands.size(); ++i) {
+        commands[i].player_id = static_cast<int>(i % 64);
+        commands[i].action = (i % 8 == 0) ? CommandAction{Join{}} : CommandAction{Flap{}};
+    }
+
+    // Journal: appends a compact record per command; simulation: applies it;
+    // metrics: counts actions by kind
+    struct Readers {
+        std::vector<uint8_t> journal;
+        DispatchState state;
+        std::array<uint64_t, std::variant_size_v<CommandAction>> by_kind{};
+        void write(const PlayerCommand& command) {
+            if (journal.size() > (size_t{1} << 20)) journal.clear(); // bounded scratch
+            journal.push_back(static_cast<uint8_t>(command.player_id));
+            journal.push_back(static_cast<uint8_t>(command.type()));
+        }
+        void apply(const PlayerCommand& command) {
+            std::visit([this](const auto& action) { state.apply(action); }, command.action);
+        }
+        void count(const PlayerCommand& command) { ++by_kind[command.action.index()]; }
+    };
+
+    Readers ring_readers;
+    auto start = bench_clock::now();
+    {
+        MulticastRing<PlayerCommand> ring(MULTICAST_CAPACITY);
+        auto& journal = ring.add_consumer();
+        auto& simulation = ring.add_consumer();
+        auto& metrics = ring.add_consumer({&journal});
+        std::thread journal_thread([&] {
+            ring.consume(journal, [&](const PlayerCommand& command, int64_t, bool) { ring_readers.write(command); });
+        });
+        std::thread simulation_thread([&] {
+            ring.consume(simulation, [&](const PlayerCommand& command, int64_t, bool) { ring_readers.apply(command); });
+        });
+        std::thread metrics_thread([&] {
+            ring.consume(metrics, [&](const PlayerCommand& command, int64_t, bool) { ring_readers.count(command); });
+        });
+        for (size_t i = 0; i < MULTICAST_ITEMS; ++i) ring.push(commands[i % commands.size()]);
+        ring.stop();
+        journal_thread.join();
+        simulation_thread.join();
+        metrics_thread.join();
+    }
+    double multicast = static_cast<double>(MULTICAST_ITEMS) /
+                       std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+
+    Readers copy_readers;
+    start = bench_clock::now();
+    {
+        RingQueue<PlayerCommand> journal(MULTICAST_CAPACITY), simulation(MULTICAST_CAPACITY), metrics(MULTICAST_CAPACITY);
+        auto reader = [](RingQueue<PlayerCommand>& queue, auto handle) {
+            return std::thread([&queue, handle] {
+                PlayerCommand command;
+                while (queue.pop(command)) handle(command);
+            });
+        };
+        std::thread journal_thread = reader(journal, [&](const PlayerCommand& c) { copy_readers.write(c); });
+        std::thread simulation_thread = reader(simulation, [&](const PlayerCommand& c) { copy_readers.apply(c); });
+        std::thread metrics_thread = reader(metrics, [&](const PlayerCommand& c) { copy_readers.count(c); });
+        for (size_t i = 0; i < MULTICAST_ITEMS; ++i) {
+            const PlayerCommand& command = commands[i % commands.size()];
+            journal.push(command);
+            simulation.push(command);
+            metrics.push(command);
+        }
+        journal.stop();
+        simulation.stop();
+        metrics.stop();
+        journal_thread.join();
+        simulation_thread.join();
+        metrics_thread.join();
+    }
+    double copies = static_cast<double>(MULTICAST_ITEMS) /
+                    std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+
+    uint64_t counted = 0;
+    for (uint64_t n : ring_readers.by_kind) counted += n;
+    std::cout << "Multicast command stream (Mcmd/s), 1 producer, journal + simulation + metrics, "
+              << MULTICAST_ITEMS << " commands\n"
+              << "  MulticastRing:     " << std::fixed << std::setprecision(2) << multicast << "\n"
+              << "  3x RingQueue copy: " << copies << "\n"
+              << "  (metrics saw " << counted << ", joins " << ring_readers.state.joins << ")\n";
+}
+
+/**
+ * @brief Checks the MulticastRing edge cases: a claim larger than the ring
+ * is rejected instead of waiting forever, and stop() while a producer waits
+ * for space fails that claim without stranding the consumers behind it.
+ * @return True if both behave
+ */
+bool multicast_stop_check() {
+    MulticastRing<int> ring(8);
+    auto& first = ring.add_consumer();
+    auto& second = ring.add_consumer({&first});
+    const bool oversized_rejected = ring.claim(ring.capacity() + 1) < 0;
+
+    for (int i = 0; i < 8; ++i) ring.push(i);
+    std::atomic<bool> blocked_push{true};
+    std::thread producer([&] { blocked_push = ring.push(8); }); // ring full: waits for space
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ring.stop();
+    producer.join();
+
+    // Both consumers must still read the 8 published items and then return
+    int read_first = 0, read_second = 0;
+    ring.consume(first, [&](const int&, int64_t, bool) { ++read_first; });
+    ring.consume(second, [&](const int&, int64_t, bool) { ++read_second; });
+
+    const bool ok = oversized_rejected && !blocked_push && read_first == 8 && read_second == 8;
+    std::cout << "MulticastRing stop/claim check: oversized claim " << (oversized_rejected ? "rejected" : "accepted")
+              << ", push during stop " << (blocked_push ? "accepted" : "failed") << ", consumers read "
+              << read_first << "/" << read_second << (ok ? "  ok" : "  FAILED") << "\n";
+    return ok;
+}
+
+/**
+ * @brief Stops a RingQueue while four producers are pushing and checks that
+ * the consumer pops every item whose push() returned true, including ones
+ * still being published when stop() landed.
+ * @return True if no accepted item was lost in any round
+ */
+bool ring_stop_check() {
+    constexpr int ROUNDS = 200;
+    constexpr int PRODUCERS = 4;
+    int lossy_rounds = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        RingQueue<int> queue(64);
+        std::atomic<size_t> accepted{0};
+        size_t popped = 0;
+        std::thread consumer([&] {
+            int item;
+            while (queue.pop(item)) ++popped;
+        });
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&] {
+                size_t mine = 0;
+                while (queue.push(1)) ++mine;
+                accepted += mine;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100 + round % 7 * 50));
+        queue.stop();
+        for (auto& producer : producers) producer.join();
+        consumer.join();
+        if (popped != accepted.load()) ++lossy_rounds;
+    }
+    std::cout << "RingQueue stop check: " << ROUNDS << " rounds, " << PRODUCERS << " producers, "
+              << lossy_rounds << " lost accepted items" << (lossy_rounds == 0 ? "  ok" : "  FAILED") << "\n";
+    return lossy_rounds == 0;
+}
+
+/**
+ * @brief Checks parallel_for and parallel_reduce against serial loops:
+ * every index is visited exactly once and partials combine in order, for
+ * empty, tiny and uneven ranges, explicit and automatic grains, and pools
+ * with 0 to 3 task workers.
+ */
+bool parallel_chunks_check() {
+    const size_t ranges[][2] = {{0, 0}, {5, 6}, {3, 10}, {0, 1000}, {17, 100'020}};
+    const size_t grains[] = {0, 1, 3, 64, 1000, 200'000};
+    size_t cases = 0;
+    size_t failures = 0;
+
+    for (size_t workers : {0, 1, 3}) {
+        ThreadPool pool(workers);
+        pool.start();
+        for (const auto& range : ranges) {
+            const size_t begin = range[0];
+            const size_t end = range[1];
+            for (size_t grain : grains) {
+                ++cases;
+                // One slot past each end, to catch chunks that overrun the range
+                std::vector<std::atomic<uint32_t>> visits(end + 1);
+                pool.parallel_for(begin, end, [&visits](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) visits[i].fetch_add(1, std::memory_order_relaxed);
+                }, grain);
+                bool once = true;
+                for (size_t i = 0; i < visits.size(); ++i) {
+                    once = once && visits[i].load() == (i >= begin && i < end ? 1u : 0u);
+                }
+
+                uint64_t serial = 0;
+                for (size_t i = begin; i < end; ++i) serial += i * i;
+                uint64_t sum = pool.parallel_reduce(begin, end, uint64_t{0},
+                    [](size_t first, size_t last) {
+                        uint64_t partial = 0;
+                        for (size_t i = first; i < last; ++i) partial += i * i;
+                        return partial;
+                    },
+                    [](uint64_t a, uint64_t b) { return a + b; }, grain);
+
+                // Chunks as [first, last) spans must join up left to right into [begin, end)
+                using Span = std::pair<size_t, size_t>;
+                const Span gap{1, 0};
+                Span joined = pool.parallel_reduce(begin, end, Span{begin, begin},
+                    [](size_t first, size_t last) { return Span{first, last}; },
+                    [gap](Span a, Span b) { return a.second == b.first ? Span{a.first, b.second} : gap; }, grain);
+
+                if (!once || sum != serial || joined != Span{begin, end}) {
+                    ++failures;
+                    std::cout << "  FAILED: " << workers << " workers, [" << begin << ", " << end << "), grain " << grain
+                              << (once ? "" : ", an index not visited exactly once")
+                              << (sum == serial ? "" : ", reduce != serial sum")
+                              << (joined == Span{begin, end} ? "" : ", partials out of order") << "\n";
+                }
+            }
+        }
+        pool.join();
+    }
+    std::cout << "parallel_for/parallel_reduce check: " << cases - failures << "/" << cases << " cases match the serial loop"
+              << (failures == 0 ? "  ok" : "  FAILED") << "\n";
+    return failures == 0;
+}
+
+// Sums every item of `queue` until it is closed
+GameTask sum_queue(AwaitableQueue<int>& queue, std::atomic<int>& sum, std::atomic<bool>& done) {
+    while (std::optional<int> item = co_await command_from(queue)) sum += *item;
+    done = true;
+}
+
+// Counts `steps` ticks of game time, one next_tick() at a time
+GameTask count_ticks(TickExecutor& ticks, int steps, std::atomic<int>& seen) {
+    for (int i = 0; i < steps; ++i) {
+        co_await ticks.next_tick();
+        ++seen;
+    }
+}
+
+// Sets a flag when destroyed, e.g. with the coroutine frame holding it
+struct DestroyFlag {
+    std::atomic<bool>& flag;
+    ~DestroyFlag() { flag = true; }
+};
+
+// Waits on a queue that is never pushed to; `destroyed` shows whether its frame was freed
+GameTask wait_forever(AwaitableQueue<int>& queue, std::atomic<bool>& waiting, std::atomic<bool>& destroyed) {
+    DestroyFlag guard{destroyed};
+    waiting = true;
+    co_await command_from(queue);
+}
+
+/**
+ * @brief Checks the coroutine paths GameState uses: items pushed to an
+ * AwaitableQueue reach a waiting coroutine, next_tick() resumes once per
+ * tick(), and destroying the executor destroys a coroutine still waiting
+ * on a queue.
+ */
+bool coroutine_check() {
+    auto wait_for = [](auto done) {
+        auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!done() && std::chrono::steady_clock::now() < give_up) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return done();
+    };
+
+    std::atomic<int> sum{0};
+    std::atomic<bool> drained{false};
+    std::atomic<int> ticks_seen{0};
+    std::atomic<bool> waiting{false};
+    std::atomic<bool> destroyed{false};
+    bool delivered = false;
+    bool ticked = false;
+    size_t live_before_shutdown = 0;
+    {
+        AwaitableQueue<int> queue;
+        AwaitableQueue<int> idle_queue;
+        ThreadPool pool(2);
+        pool.start();
+        {
+            TickExecutor ticks(pool);
+            ticks.spawn(sum_queue(queue, sum, drained));
+            ticks.spawn(count_ticks(ticks, 3, ticks_seen));
+            ticks.spawn(wait_forever(idle_queue, waiting, destroyed));
+            for (int i = 1; i <= 100; ++i) queue.push(i);
+            queue.close();
+            delivered = wait_for([&] { return drained.load(); }) && sum == 5050;
+            for (int i = 0; i < 5; ++i) {
+                ticks.tick();
+                wait_for([&] { return ticks_seen >= std::min(i + 1, 3); });
+            }
+            ticked = ticks_seen == 3;
+            wait_for([&] { return waiting.load(); });
+            live_before_shutdown = ticks.live();
+            pool.join();
+        } // the executor goes first; idle_queue must not touch the destroyed waiter afterwards
+    }
+
+    const bool ok = delivered && ticked && live_before_shutdown == 1 && destroyed;
+    std::cout << "Coroutine check: queue sum " << sum << "/5050, ticks " << ticks_seen << "/3, waiter "
+              << (destroyed ? "destroyed" : "leaked") << " at shutdown" << (ok ? "  ok" : "  FAILED") << "\n";
+    return ok;
+}
+
+// Recursive divide-and-conquer sum: the right half is posted, the left half
+// runs inline, and the caller helps out while waiting for the posted half.
+uint64_t fork_join_sum(ThreadPool& pool, uint64_t begin, uint64_t end) {
+    if (end - begin <= FORK_JOIN_LEAF) {
+        uint64_t sum = 0;
+        for (uint64_t i = begin; i < end; ++i) sum += i * i;
+        return sum;
+    }
+    uint64_t mid = begin + (end - begin) / 2;
+    std::atomic<bool> done{false};
+    uint64_t right = 0;
+    pool.post([&pool, &done, &right, mid, end] {
+        right = fork_join_sum(pool, mid, end);
+        done.store(true, std::memory_order_release);
+    });
+    uint64_t left = fork_join_sum(pool, begin, mid);
+    pool.work_until([&done] { return done.load(std::memory_order_acquire); });
+    return left + right;
+}
+
+/**
+ * @brief Times the work-stealing task pool at 1..N workers: fork-join
+ * recursion, a flood of tiny tasks posted from outside the pool (all via the
+ * injection queue), and the same flood spawned from inside a task (all on one
+ * worker's deque, spread by stealing).
+ */
+void scheduler_scaling() {
+    const size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Work-stealing ThreadPool (ms), fork-join over " << FORK_JOIN_RANGE << " items, "
+              << FLOOD_TASKS << "-task floods\n";
+    std::cout << std::setw(8) << "workers" << std::setw(12) << "fork-join" << std::setw(14) << "ext. flood"
+              << std::setw(14) << "int. flood" << "\n";
+
+    auto ms_since = [](bench_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+    };
+
+    for (size_t workers = 1; ; workers = std::min(workers * 2, max_workers)) {
+        ThreadPool pool(workers);
+        pool.start();
+
+        auto start = bench_clock::now();
+        auto sum = pool.submit([&pool] { return fork_join_sum(pool, 0, FORK_JOIN_RANGE); });
+        pool.work_until([&sum] { return sum.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        sum.get();
+        double fork_join = ms_since(start);
+
+        std::atomic<size_t> ran{0};
+        start = bench_clock::now();
+        for (size_t i = 0; i < FLOOD_TASKS; ++i) {
+            pool.post([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+        }
+        pool.work_until([&ran] { return ran.load(std::memory_order_relaxed) == FLOOD_TASKS; });
+        double external = ms_since(start);
+
+        ran.store(0);
+        start = bench_clock::now();
+        pool.post([&pool, &ran] {
+            for (size_t i = 0; i < FLOOD_TASKS; ++i) {
+                pool.post([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+        pool.work_until([&ran] { return ran.load(std::memory_order_relaxed) == FLOOD_TASKS; });
+        double internal = ms_since(start);
+
+        pool.join();
+        std::cout << std::setw(8) << workers << std::fixed << std::setprecision(1) << std::setw(12) << fork_join
+                  << std::setw(14) << external << std::setw(14) << internal << "\n";
+        if (workers == max_workers) break;
+    }
+}
+
+// A room with a little per-tick work, standing in for GameState (which needs SFML)
+struct BenchRoom {
+    float y = 10.0f;
+    float y_vel = 0.0f;
+    int steps = 32; // work per tick
+    void update_physics(float dt) {
+        for (int i = 0; i < steps; ++i) {
+            y_vel += -40.0f * dt / static_cast<float>(steps);
+            y += y_vel * dt / static_cast<float>(steps);
+        }
+        if (y < 0.0f) y = 10.0f, y_vel = 0.0f;
+    }
+};
+
+/**
+ * @brief Runs thousands of 60 Hz rooms from one RoomScheduler and reports
+ * how late their ticks start.
+ */
+void room_scheduler_report() {
+    const size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "RoomScheduler, 60 Hz rooms on " << workers << " task workers, "
+              << std::chrono::duration_cast<std::chrono::seconds>(ROOM_RUN_TIME).count() << " s each\n";
+    std::cout << std::setw(8) << "rooms" << std::setw(12) << "ticks/s" << std::setw(10) << "late %"
+              << std::setw(10) << "skipped" << std::setw(12) << "p50 (<=us)" << std::setw(12) << "p99 (<=us)"
+              << std::setw(12) << "max (us)" << "\n";
+
+    for (size_t rooms : ROOM_COUNTS) {
+        ThreadPool pool(workers);
+        pool.start();
+        RoomScheduler<BenchRoom> scheduler(pool);
+        for (size_t i = 0; i < rooms; ++i) scheduler.add_room(std::make_unique<BenchRoom>(), ROOM_PERIOD);
+        scheduler.start();
+        std::this_thread::sleep_for(ROOM_RUN_TIME);
+        scheduler.stop();
+        pool.join();
+
+        RoomSchedulerStats stats = scheduler.stats();
+        double seconds = std::chrono::duration<double>(ROOM_RUN_TIME).count();
+        double late = stats.ticks ? 100.0 * static_cast<double>(stats.late_ticks) / static_cast<double>(stats.ticks) : 0.0;
+        std::cout << std::setw(8) << rooms << std::fixed << std::setprecision(0)
+                  << std::setw(12) << static_cast<double>(stats.ticks) / seconds
+                  << std::setprecision(1) << std::setw(10) << late
+                  << std::setw(10) << stats.skipped_ticks
+                  << std::setw(12) << stats.lateness_percentile_ns(0.5) / 1000
+                  << std::setw(12) << stats.lateness_percentile_ns(0.99) / 1000
+                  << std::setw(12) << stats.max_lateness_ns / 1000 << "\n";
+    }
+}
+
+/**
+ * @brief Runs rooms in lockstep at 240 Hz and reports the barrier wait per
+ * tick, once with even room costs and once with the first group of rooms
+ * four times as expensive, which shows up as skew.
+ */
+void lockstep_report() {
+    // The caller plus one task worker per remaining participant
+    const size_t participants = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "Lockstep rooms, " << LOCKSTEP_ROOMS << " rooms on " << participants << " participants, "
+              << LOCKSTEP_TICKS << " ticks at 240 Hz\n";
+    std::cout << std::setw(8) << "load" << std::setw(12) << "busy (us)" << std::setw(14) << "wait p50 <=us"
+              << std::setw(14) << "wait p99 <=us" << std::setw(14) << "skew p99 <=us" << std::setw(14)
+              << "skew max (us)" << "\n";
+
+    for (bool skewed : {false, true}) {
+        ThreadPool pool(participants - 1);
+        pool.start();
+        RoomScheduler<BenchRoom> scheduler(pool);
+        for (size_t i = 0; i < LOCKSTEP_ROOMS; ++i) {
+            auto room = std::make_unique<BenchRoom>();
+            if (skewed && i < LOCKSTEP_ROOMS / participants) room->steps *= 4;
+            scheduler.add_room(std::move(room), LOCKSTEP_PERIOD);
+        }
+
+        LockstepConfig config;
+        config.participants = participants;
+        config.ticks = LOCKSTEP_TICKS;
+        config.period = LOCKSTEP_PERIOD;
+        LockstepStats stats = scheduler.run_lockstep(std::move(config));
+        pool.join();
+
+        uint64_t busy = 0;
+        for (uint64_t ns : stats.busy_ns) busy += ns;
+        uint64_t ticks = std::max<uint64_t>(1, stats.ticks);
+        std::cout << std::setw(8) << (skewed ? "skewed" : "even")
+                  << std::setw(12) << busy / participants / ticks / 1000
+                  << std::setw(14) << stats.wait_percentile_ns(0.5) / 1000
+                  << std::setw(14) << stats.wait_percentile_ns(0.99) / 1000
+                  << std::setw(14) << stats.skew_percentile_ns(0.99) / 1000
+                  << std::setw(14) << stats.max_skew_ns / 1000 << "\n";
+    }
+}
+
+int main() {
+    std::cout << "[Bench] hardware_concurrency = " << std::thread::hardware_concurrency() << "\n\n";
+    throughput_comparison();
+    std::cout << "\n";
+    latency_comparison();
+    std::cout << "\n";
+    instrumentation_report();
+    std::cout << "\n";
+    dispatch_comparison();
+    std::cout << "\n";
+    const bool accounting_ok = dispatcher_accounting_check();
+    const bool rebalance_ok = rebalance_check();
+    std::cout << "\n";
+    multicast_report();
+    const bool multicast_ok = multicast_stop_check();
+    const bool ring_ok = ring_stop_check();
+    const bool coroutine_ok = coroutine_check();
+    const bool chunks_ok = parallel_chunks_check();
+    std::cout << "\n";
+    scheduler_scaling();
+    std::cout << "\n";
+    room_scheduler_report();
+    std::cout << "\n";
+    lockstep_report();
+    return accounting_ok && rebalance_ok && multicast_ok && ring_ok && coroutine_ok && chunks_ok ? 0 : 1;
+}
@@ -3,27 +3,76 @@ main.cpp
 The Concurrent Flappy Bird Server with SFML Frontend: 
 1. Main Thread initializes SFML window and runs the low-latency game loop (Renderer/Input).
 2. Worker Threads (ThreadPool) consume FLAP commands and update the shared GameState.
+3. Timed game logic runs as coroutines on the pool (TickExecutor).
+4. Each frame runs as a FrameGraph of stages, so drawing frame N overlaps physics for N+1.
+5. Steady-state frames do not touch the global heap: scratch comes from the
+   per-thread arenas (ThreadArena.h), and AllocationCounter checks it.
 */
 
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <span>
 #include <variant>
 #include <type_traits>
+#include <array>
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <SFML/Graphics.hpp>  // SFML Graphics (includes Window.hpp)
 
 #include "SafeQueue.h" 
 #include "ThreadPool.h" 
+#include "ShardedDispatcher.h"
 #include "PlayerCommand.h"
 #include "GameState.h"
+#include "FrameGraph.h"
+#include "RoomScheduler.h"
+#include "ThreadArena.h"
+#include "AllocationCounter.h"
 
-// The queue holds player commands
-using CommandQueue = SafeQueue<PlayerCommand>; 
+// The queues hold player commands (CommandQueue is selected in ThreadPool.h)
 
 // Global atomic flag for shutdown coordination
 std::atomic<bool> g_running(true);
 
+// How often a worker wakes (even when idle) for periodic housekeeping
+const auto HOUSEKEEPING_INTERVAL = std::chrono::milliseconds(500);
+
+// Tick period of the optional background rooms (FLAPPY_ROOMS)
+const auto ROOM_TICK_PERIOD = std::chrono::microseconds(16667);
+
+// Frames in the stage graph at once: frame N is drawn while N+1 runs physics
+const size_t FRAMES_IN_FLIGHT = 2;
+
+// Frames before heap allocations count against the steady state (font, window,
+// first pipes and worker arenas are all set up by then)
+const uint64_t ALLOCATION_WARMUP_FRAMES = 120;
+
+// Per-frame data passed between stages; frame N uses frames[N % FRAMES_IN_FLIGHT]
+struct FrameData {
+    // Stages of one frame never overlap, so the slot's pool needs no locking
+    std::pmr::unsynchronized_pool_resource memory;
+    float frame_time = 0.0f;                                 // input: time since the previous frame
+    GameSnapshot snapshot{&memory};                          // snapshot: state to render
+    std::pmr::vector<sf::RectangleShape> pipe_shapes{&memory}; // render_prep
+    sf::CircleShape bird_shape;                              // render_prep
+};
+
+// Writes `prefix` followed by `value` into `out` (no std::to_string temporaries)
+static void format_score(std::pmr::string& out, const char* prefix, int value) {
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.assign(prefix);
+    out.append(digits, result.ptr);
+}
+
 
 // --- Main Thread: The Low-Latency Game Loop / Renderer / Input Handler (PRODUCER) ---
 int main() {
@@ -41,161 +90,306 @@ int main() {
     window.setFramerateLimit(60); // Set rendering limit to 60 FPS
 
     // 2. Setup Concurrency Components
-    CommandQueue command_queue;
-    size_t num_worker_threads = std::thread::hardware_concurrency();
-    std::cout << "[System] Starting ThreadPool with " << num_worker_threads << " physics workers.\n";
-
-    // 3. Create worker task lambda that captures game_state by reference
-    auto worker_task = [&game_state](CommandQueue& cmd_queue) {
-        PlayerCommand command;
-        // Worker runs until pop() returns false (queue stopped AND empty)
-        while (cmd_queue.pop(command)) {
-            // Apply the FLAP velocity update
-            game_state.process_command(command); 
-        }
+    // Each worker owns one shard; a player's commands always go to the same
+    // shard, so they are applied in order.
+    // hardware_concurrency() may report 0 when it cannot tell
+    size_t num_worker_threads = std::max(1u, std::thread::hardware_concurrency());
+    ShardedDispatcher dispatcher(num_worker_threads);
+    std::cout << "[System] Starting ThreadPool with up to " << num_worker_threads << " physics workers.\n";
+
+    // 3. Create the per-shard worker lambda that captures game_state by reference
+    auto shard_worker = [&game_state](ShardedDispatcher& shards, size_t shard) {
+        // Drains the shard in batches: one queue lock and one GameState lock per batch,
+        // running housekeeping on the same thread between batches
+        shards.run_shard(shard,
+            [&game_state](std::span<const PlayerCommand> commands) {
+                // Apply the FLAP velocity updates
+                game_state.process_commands(commands);
+            },
+            [&game_state] { game_state.flush_latency_warnings(); },
+            HOUSEKEEPING_INTERVAL);
     };
 
     // 4. Start the ThreadPool (Consumers)
-    // IMPORTANT: thread_pool must be declared here so it's destroyed AFTER command_queue
-    ThreadPool thread_pool(num_worker_threads, command_queue, worker_task); 
+    // IMPORTANT: thread_pool must be declared after the dispatcher so it's destroyed BEFORE it;
+    // its workers and sizer use the dispatcher until they are joined
+    // Task workers alongside the shards run parallel physics for large entity counts
+    ThreadPool thread_pool(dispatcher, shard_worker, num_worker_threads); 
+    // Optional pinning, e.g. FLAPPY_PLACEMENT=physical FLAPPY_RENDER_CPU=0
+    thread_pool.set_placement(placement_from_env());
+    // Park shard workers that only add contention; keep the fewest that hold 2ms p99
+    AdaptiveSizingConfig sizing;
+    sizing.min_workers = 1;
+    sizing.latency_target = std::chrono::microseconds(2000);
+    sizing.lock_wait_probe = [&game_state] { return game_state.lock_wait_ns(); };
+    thread_pool.enable_adaptive_sizing(std::move(sizing));
     thread_pool.start();
+    game_state.set_thread_pool(&thread_pool);
+
+    // Game-time coroutines (pipe spawning) run on the pool, one tick per physics step.
+    // Declared after thread_pool, so it is destroyed first, once the pool is joined.
+    TickExecutor game_ticks(thread_pool);
+    game_state.attach_scheduler(game_ticks);
+
+    // Optional headless rooms ticked at 60 Hz by the task workers, e.g. FLAPPY_ROOMS=10000.
+    // Their pipe lists share one pool instead of each going to the global heap.
+    std::pmr::synchronized_pool_resource room_memory;
+    RoomScheduler<GameState> rooms(thread_pool);
+    if (const char* room_env = std::getenv("FLAPPY_ROOMS")) {
+        size_t room_count = std::strtoul(room_env, nullptr, 10);
+        for (size_t i = 0; i < room_count; ++i) {
+            rooms.add_room(std::make_unique<GameState>(&room_memory), ROOM_TICK_PERIOD);
+        }
+        std::cout << "[System] Ticking " << room_count << " background rooms.\n";
+        rooms.start();
+    }
 
     // Game loop timing setup
     sf::Clock clock;
     // Target update rate for physics integration (e.g., 60 Hz or 1/60th of a second)
     const float FIXED_TIMESTEP = 1.0f / 60.0f; 
-    float accumulator = 0.0f; // Stores time since last physics update
+    float accumulator = 0.0f; // Stores time since last physics update; physics stage only
 
-    std::cout << "[Main Thread] SFML Window running. Use SPACE to FLAP.\n";
-    
-    // SFML Game Loop
-    while (window.isOpen() && g_running.load()) {
-        float frame_time = clock.restart().asSeconds();
-        accumulator += frame_time;
-
-        // --- PRODUCER (Input Handling) ---
-        // SFML 3.0: pollEvent returns std::optional<Event>
-        while (auto event_opt = window.pollEvent()) {
-            auto& event = *event_opt;
-            // Check event type using SFML 3.0 API
-            if (event.is<sf::Event::Closed>()) {
-                g_running.store(false);
-                window.close();
-            } else if (auto* key_pressed = event.getIf<sf::Event::KeyPressed>()) {
-                if (key_pressed->code == sf::Keyboard::Key::Space || key_pressed->code == sf::Keyboard::Key::Up) {
-                    // Create a PlayerCommand and push it to the queue (Producer action)
-                    // Only process if bird is alive to avoid queuing unnecessary commands
-                    auto bird_state = game_state.get_bird_state();
-                    if (bird_state.is_alive) {
+    bool paused = false; // last pause state sent to the workers
+
+    // 5. Frame stages: input -> physics -> snapshot -> render_prep -> draw.
+    // Input and draw need the SFML window and run on this thread; the others
+    // run on the pool. Physics of frame N+1 only waits for the snapshot of
+    // frame N, so building and drawing frame N overlaps the next physics step.
+    std::array<FrameData, FRAMES_IN_FLIGHT> frames;
+    auto frame_data = [&frames](uint64_t frame) -> FrameData& { return frames[frame % FRAMES_IN_FLIGHT]; };
+    FrameGraph frame_graph(thread_pool, FRAMES_IN_FLIGHT);
+
+    // Global heap allocations per frame, measured draw to draw on all threads
+    uint64_t last_allocations = global_allocations();
+    uint64_t steady_frames = 0;
+    uint64_t steady_allocations = 0;
+    uint64_t allocating_frames = 0;
+
+    // --- PRODUCER (Input Handling) ---
+    auto input = frame_graph.add_stage("input", FrameGraph::StageThread::Caller,
+        [&](uint64_t frame) {
+            frame_data(frame).frame_time = clock.restart().asSeconds();
+
+            // SFML 3.0: pollEvent returns std::optional<Event>
+            while (auto event_opt = window.pollEvent()) {
+                auto& event = *event_opt;
+                // Check event type using SFML 3.0 API
+                if (event.is<sf::Event::Closed>()) {
+                    g_running.store(false);
+                    window.close();
+                } else if (auto* key_pressed = event.getIf<sf::Event::KeyPressed>()) {
+                    if (key_pressed->code == sf::Keyboard::Key::Space || key_pressed->code == sf::Keyboard::Key::Up) {
+                        // Create a PlayerCommand and push it to the queue (Producer action)
+                        // Only process if bird is alive to avoid queuing unnecessary commands
+                        auto bird_state = game_state.get_bird_state();
+                        if (bird_state.is_alive) {
+                            PlayerCommand cmd;
+                            cmd.player_id = 1;
+                            cmd.action = Flap{};
+                            cmd.timestamp = std::chrono::high_resolution_clock::now();
+                            dispatcher.push(std::move(cmd));
+                        }
+                    } else if (key_pressed->code == sf::Keyboard::Key::H) {
+                        // Hover: stops the fall for HOVER_TICKS steps (a coroutine holds it)
+                        PlayerCommand cmd;
+                        cmd.player_id = 1;
+                        cmd.action = Ability{AbilityId::Hover};
+                        cmd.timestamp = std::chrono::high_resolution_clock::now();
+                        dispatcher.push(std::move(cmd));
+                    } else if (key_pressed->code == sf::Keyboard::Key::P) {
+                        paused = !paused;
                         PlayerCommand cmd;
                         cmd.player_id = 1;
-                        cmd.type = ActionType::FLAP;
+                        cmd.action = Pause{paused};
                         cmd.timestamp = std::chrono::high_resolution_clock::now();
-                        command_queue.push(std::move(cmd));
+                        if (!dispatcher.push(std::move(cmd))) {
+                            paused = !paused; // not applied: keep the toggle in sync with the game
+                            std::cerr << "[Input] Warning: pause command rejected by a full queue\n";
+                        }
+                    } else if (key_pressed->code == sf::Keyboard::Key::Escape) {
+                        // Allow ESC to quit the game
+                        g_running.store(false);
+                        window.close();
                     }
-                } else if (key_pressed->code == sf::Keyboard::Key::Escape) {
-                    // Allow ESC to quit the game
-                    g_running.store(false);
-                    window.close();
                 }
             }
-        }
-        
-        // --- INTEGRATOR (Physics Tick) ---
-        // Run physics updates at a fixed rate, independent of rendering speed
-        while (accumulator >= FIXED_TIMESTEP) {
-            game_state.update_physics(FIXED_TIMESTEP);
-            accumulator -= FIXED_TIMESTEP;
-        }
+        });
 
-        // --- RENDERER (Drawing the State) ---
-        // Get all game state in one lock to minimize mutex contention
-        auto bird = game_state.get_bird_state();
-        
-        // Check if the game is over BEFORE getting pipe shapes (avoid unnecessary work)
-        if (!bird.is_alive) {
-            g_running.store(false);
-        }
-        
-        auto pipe_shapes = game_state.get_drawable_pipes();
-
-        window.clear(sf::Color(135, 206, 235)); // Sky blue background
-
-        // 1. Draw Bird
-        sf::CircleShape bird_shape(BIRD_DRAW_SIZE / 2.0f);
-        bird_shape.setFillColor(sf::Color::Yellow);
-        bird_shape.setOutlineColor(sf::Color::Black);
-        bird_shape.setOutlineThickness(2.0f);
-        // Calculate screen Y from bird world Y (convert world to screen coordinates)
-        float bird_screen_y = WINDOW_HEIGHT - (bird.y * SCALE_FACTOR) - BIRD_DRAW_SIZE / 2.0f;
-        bird_shape.setPosition(sf::Vector2f(
-            bird.x * SCALE_FACTOR - BIRD_DRAW_SIZE / 2.0f,
-            bird_screen_y
-        ));
-        window.draw(bird_shape);
-
-        // 2. Draw Pipes
-        for (const auto& shape : pipe_shapes) {
-            window.draw(shape);
-        }
-        
-        // 3. Draw Score and Game Over Message
-        // Font should be loaded once, but check if it exists
-        static sf::Font font;
-        static bool font_loaded = false;
-        if (!font_loaded) {
-            // Try multiple common font paths
-            const char* font_paths[] = {
-                "/System/Library/Fonts/Supplemental/Arial.ttf",
-                "/System/Library/Fonts/Helvetica.ttc",
-                "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
-                "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
-                "C:\\Windows\\Fonts\\arial.ttf",
-                nullptr
-            };
-            for (int i = 0; font_paths[i]; ++i) {
-                if (font.openFromFile(font_paths[i])) {
-                    font_loaded = true;
-                    break;
+    // --- INTEGRATOR (Physics Tick) ---
+    // Run physics updates at a fixed rate, independent of rendering speed
+    auto physics = frame_graph.add_stage("physics", FrameGraph::StageThread::Pool,
+        [&](uint64_t frame) {
+            accumulator += frame_data(frame).frame_time;
+            while (accumulator >= FIXED_TIMESTEP) {
+                game_state.update_physics(FIXED_TIMESTEP);
+                accumulator -= FIXED_TIMESTEP;
+            }
+        }, {input});
+
+    // Get all game state in one lock to minimize mutex contention
+    auto snapshot = frame_graph.add_stage("snapshot", FrameGraph::StageThread::Pool,
+        [&](uint64_t frame) {
+            FrameData& data = frame_data(frame);
+            game_state.snapshot(data.snapshot);
+            if (!data.snapshot.bird.is_alive) {
+                g_running.store(false);
+            }
+        }, {physics});
+    frame_graph.after_previous_frame(physics, snapshot);
+
+    // --- RENDERER (Building draw data off the render thread) ---
+    auto render_prep = frame_graph.add_stage("render_prep", FrameGraph::StageThread::Pool,
+        [&](uint64_t frame) {
+            FrameData& data = frame_data(frame);
+            GameState::build_pipe_shapes(data.snapshot.pipes, data.pipe_shapes);
+
+            const BirdState& bird = data.snapshot.bird;
+            data.bird_shape.setRadius(BIRD_DRAW_SIZE / 2.0f);
+            data.bird_shape.setFillColor(sf::Color::Yellow);
+            data.bird_shape.setOutlineColor(sf::Color::Black);
+            data.bird_shape.setOutlineThickness(2.0f);
+            // Calculate screen Y from bird world Y (convert world to screen coordinates)
+            float bird_screen_y = WINDOW_HEIGHT - (bird.y * SCALE_FACTOR) - BIRD_DRAW_SIZE / 2.0f;
+            data.bird_shape.setPosition(sf::Vector2f(
+                bird.x * SCALE_FACTOR - BIRD_DRAW_SIZE / 2.0f,
+                bird_screen_y
+            ));
+        }, {snapshot});
+
+    // --- RENDERER (Drawing the State) ---
+    frame_graph.add_stage("draw", FrameGraph::StageThread::Caller,
+        [&](uint64_t frame) {
+            const FrameData& data = frame_data(frame);
+            const BirdState& bird = data.snapshot.bird;
+
+            window.clear(sf::Color(135, 206, 235)); // Sky blue background
+
+            // 1. Draw Bird
+            window.draw(data.bird_shape);
+
+            // 2. Draw Pipes
+            for (const auto& shape : data.pipe_shapes) {
+                window.draw(shape);
+            }
+
+            // 3. Draw Score and Game Over Message
+            // Font should be loaded once, but check if it exists
+            static sf::Font font;
+            static bool font_loaded = false;
+            if (!font_loaded) {
+                // Try multiple common font paths
+                const char* font_paths[] = {
+                    "/System/Library/Fonts/Supplemental/Arial.ttf",
+                    "/System/Library/Fonts/Helvetica.ttc",
+                    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+                    "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+                    "C:\\Windows\\Fonts\\arial.ttf",
+                    nullptr
+                };
+                for (int i = 0; font_paths[i]; ++i) {
+                    if (font.openFromFile(font_paths[i])) {
+                        font_loaded = true;
+                        break;
+                    }
                 }
             }
-        }
-        
-        if (font_loaded) {
-            sf::Text score_text(font, "Score: " + std::to_string(bird.score), 30);
-            score_text.setFillColor(sf::Color::Black);
-            score_text.setPosition(sf::Vector2f(WINDOW_WIDTH - 150, 10));
-            window.draw(score_text);
-
-            if (!bird.is_alive) {
-                sf::Text game_over_text(font, "GAME OVER!\nFinal Score: " + std::to_string(bird.score) + "\n(Close Window)", 50);
-                game_over_text.setFillColor(sf::Color::Red);
-                game_over_text.setStyle(sf::Text::Style::Bold);
-                // Center the text
-                sf::FloatRect textRect = game_over_text.getLocalBounds();
-                game_over_text.setOrigin(sf::Vector2f(textRect.size.x / 2.0f, textRect.size.y / 2.0f));
-                game_over_text.setPosition(sf::Vector2f(WINDOW_WIDTH/4.0f, WINDOW_HEIGHT/2.0f));
-                window.draw(game_over_text);
+
+            if (font_loaded) {
+                // Texts persist across frames and are only re-laid out when the
+                // score changes; the strings are scratch on this stage's arena
+                static std::optional<sf::Text> score_text;
+                static std::optional<sf::Text> game_over_text;
+                static int shown_score = -1;
+                std::pmr::string message(&thread_arena());
+                if (!score_text) {
+                    score_text.emplace(font, "", 30);
+                    score_text->setFillColor(sf::Color::Black);
+                    score_text->setPosition(sf::Vector2f(WINDOW_WIDTH - 150, 10));
+                }
+                if (bird.score != shown_score) {
+                    format_score(message, "Score: ", bird.score);
+                    score_text->setString(message.c_str());
+                    shown_score = bird.score;
+                }
+                window.draw(*score_text);
+
+                if (!bird.is_alive) {
+                    if (!game_over_text) {
+                        format_score(message, "GAME OVER!\nFinal Score: ", bird.score);
+                        message += "\n(Close Window)";
+                        game_over_text.emplace(font, message.c_str(), 50);
+                        game_over_text->setFillColor(sf::Color::Red);
+                        game_over_text->setStyle(sf::Text::Style::Bold);
+                        // Center the text
+                        sf::FloatRect textRect = game_over_text->getLocalBounds();
+                        game_over_text->setOrigin(sf::Vector2f(textRect.size.x / 2.0f, textRect.size.y / 2.0f));
+                        game_over_text->setPosition(sf::Vector2f(WINDOW_WIDTH/4.0f, WINDOW_HEIGHT/2.0f));
+                    }
+                    window.draw(*game_over_text);
+                }
             }
-        }
 
-        window.display();
+            window.display();
+
+            uint64_t allocations = global_allocations();
+            if (frame >= ALLOCATION_WARMUP_FRAMES) {
+                ++steady_frames;
+                steady_allocations += allocations - last_allocations;
+                if (allocations != last_allocations) ++allocating_frames;
+            }
+            last_allocations = allocations;
+        }, {render_prep});
+
+    std::cout << "[Main Thread] SFML Window running. Use SPACE to FLAP, H to hover, P to pause.\n";
+    
+    // SFML Game Loop: each submit starts a frame and runs ready caller stages
+    // (input, draw) until a frame slot is free
+    while (window.isOpen() && g_running.load()) {
+        frame_graph.submit_frame();
     }
+    frame_graph.drain();
+    std::cout << "[System] Frame stage timings:\n" << frame_graph.summarize_timings();
+    std::cout << "[System] Steady-state heap allocations: " << steady_allocations << " over "
+              << steady_frames << " frames (" << allocating_frames << " frames allocated)\n";
     
+    rooms.stop();
+    RoomSchedulerStats room_stats = rooms.stats();
+    if (room_stats.rooms > 0) {
+        std::cout << "[System] Rooms: " << room_stats.ticks << " ticks, " << room_stats.late_ticks << " late, "
+                  << room_stats.skipped_ticks << " skipped, lateness p99 <="
+                  << room_stats.lateness_percentile_ns(0.99) / 1000 << "us, max "
+                  << room_stats.max_lateness_ns / 1000 << "us\n";
+    }
+
     std::cout << "[System] Signaling workers to stop and joining threads...\n";
     
     // STEP 1: Stop accepting new commands - signals workers to exit their loops
-    command_queue.stop();
+    dispatcher.stop();
     
     // STEP 2: Wait for all worker threads to fully exit
     // This ensures ALL mutex locks are released before we continue
     thread_pool.join(); 
     
     std::cout << "[System] All worker threads have exited.\n";
+
+    // Per-worker utilization; FLAPPY_METRICS_CSV=<path> also writes it as CSV
+    PoolMetrics pool_metrics = thread_pool.metrics();
+    std::cout << "[System] Worker metrics:\n" << describe_metrics(pool_metrics);
+    std::cout << "[System] GameState lock wait: " << game_state.lock_wait_ns() / 1000 << "us on commands, "
+              << game_state.total_lock_wait_ns() / 1000 << "us on all paths\n";
+    if (const char* csv_path = std::getenv("FLAPPY_METRICS_CSV")) {
+        std::ofstream csv(csv_path);
+        if (csv) {
+            csv << metrics_to_csv(pool_metrics);
+        } else {
+            std::cerr << "[System] Warning: cannot write worker metrics to " << csv_path << std::endl;
+        }
+    }
     
     // STEP 3: Now automatic destruction happens in the correct order:
     //   - thread_pool destructor runs (checks m_joined=true, does nothing)
-    //   - command_queue destructor runs (safe, no threads using it)
+    //   - dispatcher destructor runs (safe, no threads using its queues)
     //   - game_state destructor runs (safe, no threads accessing it)
     
     std::cout << "Simulation finished. Concurrent resources joined safely.\n";
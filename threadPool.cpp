@@ -8,36 +8,74 @@ tasks from the queue using a user-provided handler.
 */
 
 #include "ThreadPool.h"
+#include "ShardedDispatcher.h"
 #include <iostream>
+#include <exception>
+#include <algorithm>
+#include <memory>
+#include <random>
 
 // The provided main.cpp already includes the necessary dependencies:
 // SafeQueue.h, PlayerCommand.h, ThreadPool.h, GameState.h
 
 // Constructor
-ThreadPool::ThreadPool(size_t num_threads, CommandQueue& command_queue_ref, WorkerTaskFunc worker_func)
-    : m_command_queue(command_queue_ref), 
+ThreadPool::ThreadPool(size_t num_threads, CommandQueue& command_queue_ref, WorkerTaskFunc worker_func,
+                       size_t num_task_threads)
+    : m_command_queue(&command_queue_ref), 
       m_worker_task_func(worker_func),
       m_num_threads(num_threads),
+      m_num_task_threads(num_task_threads),
       m_joined(false) 
 {
     // The threads are created and launched in the start() method.
 }
 
+// Constructor (sharded mode): one worker per shard
+ThreadPool::ThreadPool(ShardedDispatcher& dispatcher, ShardWorkerFunc shard_worker_func,
+                       size_t num_task_threads)
+    : m_dispatcher(&dispatcher),
+      m_shard_worker_func(shard_worker_func),
+      m_num_threads(dispatcher.shard_count()),
+      m_num_task_threads(num_task_threads),
+      m_joined(false)
+{
+}
+
+// Constructor (task mode): task workers only
+ThreadPool::ThreadPool(size_t num_task_threads)
+    : m_num_threads(0),
+      m_num_task_threads(num_task_threads),
+      m_joined(false)
+{
+}
+
 // Destructor
 ThreadPool::~ThreadPool() {
     // IMPORTANT: Destructor should NEVER run if join() was properly called
     // If this destructor runs and threads are still active, something went wrong
-    // We can't safely join here because the queue might already be destroyed
+    // We can't safely join the command workers because their queue might
+    // already be destroyed, but the sizer and task loops only use the pool
     if (!m_joined.load()) {
         std::cerr << "[ThreadPool] ERROR: Destructor called without join()! This should not happen." << std::endl;
-        // Don't try to join here - it's too late, objects may be destroyed
-        // Just detach threads to avoid std::terminate (but this is a last resort)
+        stop_sizer();
+        stop_tasks();
+        for (size_t i = m_num_threads; i < m_threads.size(); ++i) {
+            if (m_threads[i].joinable()) m_threads[i].join(); // task workers exit once their queues drain
+        }
+        // Just detach command workers to avoid std::terminate (but this is a last resort)
         for (std::thread& worker : m_threads) {
             if (worker.joinable()) {
                 worker.detach(); // Detach to avoid terminate, but this is bad practice
             }
         }
     }
+
+    // No task worker is running any more; release tasks that never ran
+    for (Task* task : m_injected) delete task;
+    for (Task* node : m_spare_nodes) delete node;
+    for (auto& worker : m_task_workers) {
+        while (Task* task = worker->deque.pop()) delete task;
+    }
 }
 
 
@@ -45,10 +83,263 @@ ThreadPool::~ThreadPool() {
  * @brief The main function executed by each worker thread.
  * It simply calls the user-provided function, which contains the queue processing loop.
  */
-void ThreadPool::worker_loop() {
-    // Execute the user-defined task handler function, passing the command queue reference.
-    // In this case, this handler contains the while (pop) loop from main.cpp.
-    m_worker_task_func(m_command_queue);
+void ThreadPool::worker_loop(size_t index) {
+    t_worker_counters = m_worker_counters[index].get();
+    if (index >= m_num_threads) {
+        // Workers past the command loop ones serve the task queues
+        task_loop(index - m_num_threads);
+    } else if (m_dispatcher) {
+        // Sharded mode: this worker owns shard `index` of the dispatcher.
+        m_shard_worker_func(*m_dispatcher, index);
+    } else {
+        // Execute the user-defined task handler function, passing the command queue reference.
+        // In this case, this handler contains the while (pop) loop from main.cpp.
+        m_worker_task_func(*m_command_queue);
+    }
+    t_worker_counters = nullptr;
+}
+
+
+namespace {
+
+// The pool and worker the current thread serves as a task worker, if any
+thread_local ThreadPool* t_task_pool = nullptr;
+thread_local void* t_task_worker = nullptr;
+
+// Recycled task nodes, so steady-state posting does not hit the allocator.
+// Each thread caches up to 2 * TASK_NODE_BATCH nodes; a node freed on another
+// thread than it was allocated on moves caches, and ThreadPool::free_task_node
+// and make_task_node even out that flow through the pool in batches.
+constexpr size_t TASK_NODE_BATCH = 8;
+constexpr size_t TASK_NODE_CACHE = 1024; // pool-wide spare nodes
+thread_local std::vector<std::unique_ptr<Task>> t_task_nodes;
+
+std::vector<std::unique_ptr<Task>>& local_task_nodes() {
+    if (t_task_nodes.capacity() == 0) t_task_nodes.reserve(2 * TASK_NODE_BATCH);
+    return t_task_nodes;
+}
+
+} // namespace
+
+Task* ThreadPool::make_task_node(Task&& task) {
+    auto& nodes = local_task_nodes();
+    if (nodes.empty()) {
+        std::lock_guard<std::mutex> lock(m_node_mutex);
+        for (size_t i = 0; i < TASK_NODE_BATCH && !m_spare_nodes.empty(); ++i) {
+            nodes.emplace_back(m_spare_nodes.back());
+            m_spare_nodes.pop_back();
+        }
+    }
+    if (nodes.empty()) return new Task(std::move(task));
+    Task* node = nodes.back().release();
+    nodes.pop_back();
+    *node = std::move(task);
+    return node;
+}
+
+void ThreadPool::free_task_node(Task* node) {
+    *node = Task(); // release captures now
+    auto& nodes = local_task_nodes();
+    nodes.emplace_back(node);
+    if (nodes.size() < 2 * TASK_NODE_BATCH) return;
+    std::lock_guard<std::mutex> lock(m_node_mutex);
+    if (m_spare_nodes.capacity() == 0) m_spare_nodes.reserve(TASK_NODE_CACHE);
+    for (size_t i = 0; i < TASK_NODE_BATCH; ++i) {
+        Task* spare = nodes.back().release();
+        nodes.pop_back();
+        if (m_spare_nodes.size() < TASK_NODE_CACHE) m_spare_nodes.push_back(spare);
+        else delete spare;
+    }
+}
+
+void ThreadPool::schedule(Task&& task) {
+    if (t_task_pool == this) {
+        // Spawned by one of our task workers: keep it local
+        static_cast<TaskWorker*>(t_task_worker)->deque.push(make_task_node(std::move(task)));
+    } else {
+        std::unique_lock<std::mutex> lock(m_inject_mutex);
+        if (m_tasks_stopped) {
+            lock.unlock();
+            run_task(task);
+            return;
+        }
+        m_injected.push_back(make_task_node(std::move(task)));
+    }
+    m_pending_tasks.fetch_add(1, std::memory_order_seq_cst);
+    wake_task_worker();
+}
+
+void ThreadPool::wake_task_worker() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_task_sleepers.load(std::memory_order_seq_cst) > 0) {
+        m_task_signal.fetch_add(1, std::memory_order_seq_cst);
+        m_task_signal.notify_one();
+    }
+}
+
+Task* ThreadPool::find_task(TaskWorker* self) {
+    if (m_pending_tasks.load(std::memory_order_relaxed) == 0) return nullptr;
+
+    Task* task = self ? self->deque.pop() : nullptr;
+    if (!task) {
+        std::lock_guard<std::mutex> lock(m_inject_mutex);
+        if (!m_injected.empty()) {
+            task = m_injected.front();
+            m_injected.pop_front();
+        }
+    }
+    if (!task && !m_task_workers.empty()) {
+        // Random start, then sweep every other worker once
+        thread_local std::minstd_rand helper_rng(std::random_device{}());
+        size_t start = self ? self->rng() : helper_rng();
+        for (size_t i = 0; i < m_task_workers.size() && !task; ++i) {
+            TaskWorker* victim = m_task_workers[(start + i) % m_task_workers.size()].get();
+            if (victim != self) task = victim->deque.steal();
+        }
+        if (task && self) WorkerCounters::add(t_worker_counters->steals, 1);
+    }
+    if (task) m_pending_tasks.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void ThreadPool::task_loop(size_t worker) {
+    TaskWorker* self = m_task_workers[worker].get();
+    t_task_pool = this;
+    t_task_worker = self;
+    WorkerCounters& counters = *t_worker_counters;
+
+    // Time between tasks is idle (searching, spinning or parked); one clock
+    // read per task boundary
+    auto mark = std::chrono::steady_clock::now();
+    for (;;) {
+        if (Task* task = find_task(self)) {
+            auto start = std::chrono::steady_clock::now();
+            WorkerCounters::add(counters.idle_ns, start - mark);
+            run_task(*task);
+            free_task_node(task);
+            mark = std::chrono::steady_clock::now();
+            WorkerCounters::add(counters.busy_ns, mark - start);
+            WorkerCounters::add(counters.tasks, 1);
+            continue;
+        }
+        if (m_task_stop.load(std::memory_order_acquire)
+            && m_pending_tasks.load(std::memory_order_acquire) == 0) {
+            break;
+        }
+        // Park until a task is posted; re-check after registering as a sleeper
+        m_task_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t signal = m_task_signal.load(std::memory_order_seq_cst);
+        if (m_pending_tasks.load(std::memory_order_seq_cst) == 0 && !m_task_stop.load(std::memory_order_seq_cst)) {
+            m_task_signal.wait(signal, std::memory_order_seq_cst);
+        }
+        m_task_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    WorkerCounters::add(counters.idle_ns, std::chrono::steady_clock::now() - mark);
+
+    t_task_pool = nullptr;
+    t_task_worker = nullptr;
+}
+
+void ThreadPool::run_task(Task& task) {
+    // Whatever the task took from thread_arena() is released when it ends
+    ArenaScope scope;
+    try {
+        task();
+    } catch (const std::exception& e) {
+        std::cerr << "[ThreadPool] Warning: posted task threw: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "[ThreadPool] Warning: posted task threw an unknown exception" << std::endl;
+    }
+}
+
+bool ThreadPool::run_pending_task() {
+    TaskWorker* self = t_task_pool == this ? static_cast<TaskWorker*>(t_task_worker) : nullptr;
+    Task* task = find_task(self);
+    if (!task) return false;
+    // Nested in the caller's work, so it adds to the task count but not to busy time
+    if (self) WorkerCounters::add(t_worker_counters->tasks, 1);
+    run_task(*task);
+    free_task_node(task);
+    return true;
+}
+
+
+void ThreadPool::ChunkJob::drain() {
+    for (;;) {
+        size_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= chunks) return;
+        size_t chunk_begin = begin + chunk * grain;
+        size_t chunk_end = std::min(end, chunk_begin + grain);
+        if (!failed.load(std::memory_order_relaxed)) {
+            try {
+                run(fn, chunk, chunk_begin, chunk_end);
+            } catch (...) {
+                if (!failed.exchange(true)) error = std::current_exception();
+            }
+        }
+        done.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+ThreadPool::ChunkJob* ThreadPool::acquire_chunk_job() {
+    ChunkJob* job = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_job_mutex);
+        if (!m_spare_jobs.empty()) {
+            job = m_spare_jobs.back();
+            m_spare_jobs.pop_back();
+        } else {
+            job = m_chunk_jobs.emplace_back(std::make_unique<ChunkJob>()).get();
+            m_spare_jobs.reserve(m_chunk_jobs.capacity()); // releasing never allocates
+        }
+    }
+    job->next.store(0, std::memory_order_relaxed);
+    job->done.store(0, std::memory_order_relaxed);
+    job->failed.store(false, std::memory_order_relaxed);
+    job->error = nullptr;
+    return job;
+}
+
+void ThreadPool::release_chunk_job(ChunkJob* job) {
+    if (job->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    std::lock_guard<std::mutex> lock(m_job_mutex);
+    m_spare_jobs.push_back(job);
+}
+
+void ThreadPool::run_chunks(size_t begin, size_t end, size_t grain,
+                            void (*run)(void*, size_t, size_t, size_t), void* fn) {
+    if (end <= begin) return;
+    grain = grain_for(end - begin, grain);
+
+    // Pooled rather than make_shared, so a parallel tick does not allocate
+    ChunkJob* job = acquire_chunk_job();
+    job->begin = begin;
+    job->end = end;
+    job->grain = grain;
+    job->chunks = (end - begin + grain - 1) / grain;
+    job->run = run;
+    job->fn = fn;
+
+    // One helper per chunk beyond the caller's, at most one per task worker
+    size_t helpers = std::min(job->chunks - 1, m_num_task_threads);
+    job->refs.store(helpers + 1, std::memory_order_relaxed);
+    for (size_t i = 0; i < helpers; ++i) {
+        post([this, job] {
+            job->drain();
+            release_chunk_job(job);
+        });
+    }
+    job->drain();
+
+    // Only chunks already claimed by helpers remain; wait for those without
+    // running unrelated tasks (the caller may be holding a lock)
+    while (job->done.load(std::memory_order_acquire) < job->chunks) {
+        std::this_thread::yield();
+    }
+    std::exception_ptr error = job->failed.load(std::memory_order_acquire) ? job->error : nullptr;
+    release_chunk_job(job);
+    if (error) std::rethrow_exception(error);
 }
 
 
@@ -56,11 +347,290 @@ void ThreadPool::worker_loop() {
  * @brief Creates and launches all worker threads, starting the consumption process.
  */
 void ThreadPool::start() {
-    for (size_t i = 0; i < m_num_threads; ++i) {
+    for (size_t i = 0; i < m_num_threads + m_num_task_threads; ++i) {
+        m_worker_counters.push_back(std::make_unique<WorkerCounters>());
+    }
+    std::random_device seed;
+    for (size_t i = 0; i < m_num_task_threads; ++i) {
+        m_task_workers.emplace_back(new TaskWorker{WorkStealingDeque<Task>(), std::minstd_rand(seed())});
+    }
+    for (size_t i = 0; i < m_num_threads + m_num_task_threads; ++i) {
         // Create a new thread and move it into the vector.
         // The worker_loop function is executed when the thread starts.
-        m_threads.emplace_back(&ThreadPool::worker_loop, this);
+        m_threads.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+    apply_placement();
+
+    if (m_sizer) {
+        m_dispatcher->set_active_shards(m_sizer->config().max_workers);
+        std::cout << "[ThreadPool] Adaptive sizing: " << m_sizer->config().min_workers << " to "
+                  << m_sizer->config().max_workers << " workers, p99 target "
+                  << m_sizer->config().latency_target.count() << "us" << std::endl;
+        m_sizer_thread = std::thread(&ThreadPool::sizing_loop, this);
+    }
+}
+
+PoolMetrics ThreadPool::metrics() const {
+    PoolMetrics metrics;
+    metrics.at = std::chrono::steady_clock::now();
+    metrics.workers.reserve(m_worker_counters.size());
+    for (size_t i = 0; i < m_worker_counters.size(); ++i) {
+        const WorkerCounters& counters = *m_worker_counters[i];
+        WorkerMetrics worker;
+        worker.index = i;
+        worker.role = i >= m_num_threads ? WorkerRole::Task : (m_dispatcher ? WorkerRole::Shard : WorkerRole::Command);
+        worker.busy_ns = counters.busy_ns.load(std::memory_order_relaxed);
+        worker.idle_ns = counters.idle_ns.load(std::memory_order_relaxed);
+        worker.lock_wait_ns = counters.lock_wait_ns.load(std::memory_order_relaxed);
+        worker.tasks = counters.tasks.load(std::memory_order_relaxed);
+        worker.steals = counters.steals.load(std::memory_order_relaxed);
+        worker.commands = counters.commands.load(std::memory_order_relaxed);
+        metrics.workers.push_back(worker);
+    }
+    return metrics;
+}
+
+LockstepStats ThreadPool::run_lockstep(LockstepConfig config,
+                                       const std::function<void(size_t participant, uint64_t tick)>& step) {
+    using Clock = std::chrono::steady_clock;
+    auto ns = [](Clock::duration d) {
+        return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    };
+    const size_t capacity = max_lockstep_participants();
+    const size_t participants = config.participants ? config.participants : capacity;
+    if (participants > capacity) {
+        // A participant that never gets a worker would hold the barrier forever
+        std::cerr << "[ThreadPool] Warning: run_lockstep needs " << participants << " participants but only "
+                  << capacity << " can run (task workers + caller); not running" << std::endl;
+        return LockstepStats{};
+    }
+
+    LockstepStats stats;
+    stats.participants = participants;
+    stats.busy_ns.assign(participants, 0);
+    stats.wait_ns.assign(participants, 0);
+    LatencyHistogram waits;
+    LatencyHistogram skew;
+
+    // Each participant stamps its arrival; the one completing the tick turns
+    // the stamps into waits. The barrier orders all of this, so no locks.
+    std::vector<Clock::time_point> arrivals(participants);
+    std::vector<uint64_t> tick_waits(participants);
+    uint64_t tick = 0;
+    PhaseBarrier barrier(participants, [&] {
+        auto released = Clock::now();
+        uint64_t longest = 0;
+        for (size_t p = 0; p < participants; ++p) {
+            tick_waits[p] = ns(released - arrivals[p]);
+            stats.wait_ns[p] += tick_waits[p];
+            waits.record(std::chrono::nanoseconds(tick_waits[p]));
+            longest = std::max(longest, tick_waits[p]);
+        }
+        skew.record(std::chrono::nanoseconds(longest));
+        stats.max_skew_ns = std::max(stats.max_skew_ns, longest);
+        if (config.on_tick) config.on_tick(tick, tick_waits);
+        ++tick;
+    }, config.spin);
+
+    const auto start = Clock::now();
+    auto participant = [&](size_t p) {
+        for (uint64_t t = 0; t < config.ticks; ++t) {
+            if (config.period.count() > 0) std::this_thread::sleep_until(start + config.period * t);
+            auto begin = Clock::now();
+            try {
+                step(p, t);
+            } catch (const std::exception& e) {
+                // Still arrive: the others would wait forever otherwise
+                std::cerr << "[ThreadPool] Warning: lockstep participant " << p << " threw in tick " << t
+                          << ": " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "[ThreadPool] Warning: lockstep participant " << p << " threw in tick " << t
+                          << ": unknown exception" << std::endl;
+            }
+            arrivals[p] = Clock::now();
+            stats.busy_ns[p] += ns(arrivals[p] - begin);
+            barrier.arrive_and_wait();
+        }
+    };
+
+    // Participants 1.. run as tasks, so they get the workers' placement and
+    // counters; each holds its worker until the last tick
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t running = participants - 1;
+    for (size_t p = 1; p < participants; ++p) {
+        post([&, p] {
+            participant(p);
+            // Notified under the lock: the caller may return as soon as it sees 0
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--running == 0) done_cv.notify_one();
+        });
+    }
+    participant(0);
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&running] { return running == 0; });
+    }
+
+    stats.ticks = tick;
+    stats.barrier_wait = waits.snapshot();
+    stats.tick_skew = skew.snapshot();
+    return stats;
+}
+
+size_t ThreadPool::max_lockstep_participants() const {
+    {
+        std::lock_guard<std::mutex> lock(m_inject_mutex);
+        if (m_tasks_stopped) return 1;
+    }
+    // A task worker calling run_lockstep is participant 0 itself
+    return t_task_pool == this ? m_num_task_threads : m_num_task_threads + 1;
+}
+
+void ThreadPool::apply_placement() {
+    if (m_placement.mode == PlacementMode::None && m_placement.render_cpu < 0) return;
+
+    CpuTopology topology = CpuTopology::detect();
+    PlacementPlan plan = plan_placement(m_placement, topology, m_threads.size());
+    size_t failed = 0;
+    if (plan.render_cpu >= 0 && !pin_current_thread(plan.render_cpu)) ++failed;
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        if (plan.worker_cpus[i] >= 0 && !pin_thread(m_threads[i], plan.worker_cpus[i])) ++failed;
+    }
+
+    std::cout << "[ThreadPool] Thread placement:\n" << describe_placement(plan, topology);
+    if (failed > 0) {
+        std::cerr << "[ThreadPool] Warning: " << failed
+                  << " thread(s) could not be pinned (unsupported platform or CPU not allowed)" << std::endl;
+    }
+}
+
+
+namespace {
+
+// Cumulative counters across all shards; a LoadSample is the difference of two
+struct LoadCounters {
+    std::chrono::steady_clock::time_point at;
+    uint64_t busy_ns = 0;
+    uint64_t completed = 0;
+    uint64_t lock_wait_ns = 0;
+    size_t depth = 0;
+    HistogramCounts queue_wait{};
+};
+
+// Queues with stats() (SafeQueue) report their depth and wait times. Others
+// fall back to the dispatcher's in-flight count, which also includes
+// commands the queue merged or dropped internally.
+template <typename Queue>
+size_t add_queue_stats(const Queue& queue, size_t in_flight, HistogramCounts& waits) {
+    if constexpr (requires { queue.stats(); }) {
+        QueueStatsSnapshot stats = queue.stats();
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) waits[b] += stats.queue_wait[b];
+        return stats.depth;
+    } else {
+        return in_flight;
+    }
+}
+
+LoadCounters read_load_counters(const ShardedDispatcher& dispatcher, const AdaptiveSizingConfig& config) {
+    LoadCounters counters;
+    counters.at = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < dispatcher.shard_count(); ++i) {
+        counters.busy_ns += dispatcher.busy_ns(i);
+        counters.completed += dispatcher.completed(i);
+        counters.depth += add_queue_stats(dispatcher.shard(i), dispatcher.in_flight(i), counters.queue_wait);
+    }
+    if (config.lock_wait_probe) counters.lock_wait_ns = config.lock_wait_probe();
+    return counters;
+}
+
+LoadSample load_between(const LoadCounters& before, const LoadCounters& after, const ShardedDispatcher& dispatcher) {
+    LoadSample sample;
+    sample.active_workers = dispatcher.active_shards();
+    sample.queue_depth = after.depth;
+    sample.commands = after.completed - before.completed;
+
+    HistogramCounts waits{};
+    for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) waits[b] = after.queue_wait[b] - before.queue_wait[b];
+    sample.queue_wait_p99_ns = histogram_percentile_lower_ns(waits, 0.99);
+
+    const double elapsed_ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(after.at - before.at).count());
+    const double busy_ns = static_cast<double>(after.busy_ns - before.busy_ns);
+    if (elapsed_ns > 0.0) {
+        // Parked shards applying strays count too, so cap at fully busy
+        sample.utilization = std::min(1.0, busy_ns / (elapsed_ns * static_cast<double>(sample.active_workers)));
+    }
+    if (busy_ns > 0.0) {
+        sample.lock_wait_share = std::min(1.0, static_cast<double>(after.lock_wait_ns - before.lock_wait_ns) / busy_ns);
     }
+    return sample;
+}
+
+} // namespace
+
+void ThreadPool::enable_adaptive_sizing(AdaptiveSizingConfig config) {
+    if (!m_dispatcher) {
+        std::cerr << "[ThreadPool] Warning: adaptive sizing needs sharded mode; keeping "
+                  << m_num_threads << " workers" << std::endl;
+        return;
+    }
+    m_sizer = std::make_unique<AdaptiveSizer>(std::move(config), m_dispatcher->shard_count());
+}
+
+size_t ThreadPool::active_workers() const {
+    return m_dispatcher ? m_dispatcher->active_shards() : m_num_threads;
+}
+
+std::vector<ResizeEvent> ThreadPool::resize_log() const {
+    std::lock_guard<std::mutex> lock(m_sizer_mutex);
+    return m_resize_log;
+}
+
+void ThreadPool::sizing_loop() {
+    const AdaptiveSizingConfig& config = m_sizer->config();
+    LoadCounters before = read_load_counters(*m_dispatcher, config);
+
+    std::unique_lock<std::mutex> lock(m_sizer_mutex);
+    while (!m_sizer_cv.wait_for(lock, config.interval, [this] { return m_sizer_stop; })) {
+        lock.unlock();
+        LoadCounters after = read_load_counters(*m_dispatcher, config);
+        LoadSample sample = load_between(before, after, *m_dispatcher);
+        before = after;
+
+        ResizeDecision decision = m_sizer->evaluate(sample);
+        if (decision.workers != sample.active_workers) {
+            m_dispatcher->set_active_shards(decision.workers);
+            ResizeEvent event{after.at, sample.active_workers, decision.workers, decision.reason, sample};
+            std::cout << "[ThreadPool] Resize: " << describe_resize(event) << std::endl;
+            lock.lock();
+            if (m_resize_log.size() == RESIZE_LOG_CAPACITY) m_resize_log.erase(m_resize_log.begin());
+            m_resize_log.push_back(event);
+        } else {
+            lock.lock();
+        }
+    }
+}
+
+void ThreadPool::stop_sizer() {
+    if (!m_sizer_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_sizer_mutex);
+        m_sizer_stop = true;
+    }
+    m_sizer_cv.notify_all();
+    m_sizer_thread.join();
+}
+
+
+void ThreadPool::stop_tasks() {
+    {
+        std::lock_guard<std::mutex> lock(m_inject_mutex);
+        m_tasks_stopped = true;
+    }
+    m_task_stop.store(true, std::memory_order_seq_cst);
+    m_task_signal.fetch_add(1, std::memory_order_seq_cst);
+    m_task_signal.notify_all();
 }
 
 
@@ -74,8 +644,15 @@ void ThreadPool::join() {
         return;
     }
 
-    // Join all threads safely - wait for each one to fully exit
-    for (std::thread& worker : m_threads) {
+    // The controller goes first so it does not resize shards that are shutting down
+    stop_sizer();
+
+    // Join all threads safely - wait for each one to fully exit.
+    // Command-loop workers (first m_num_threads) go first, since they may
+    // still post tasks; then the task queue is stopped and drained.
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        if (i == m_num_threads) stop_tasks();
+        std::thread& worker = m_threads[i];
         if (worker.joinable()) {
             try {
                 // This will block until the thread exits
@@ -92,6 +669,8 @@ void ThreadPool::join() {
         }
     }
     
+    stop_tasks(); // no task workers, or start() was never called
+
     // Clear the thread vector after all threads are joined
     // This ensures destructor won't try to join again
     m_threads.clear();